@@ -0,0 +1,101 @@
+#include "concurrentdnadb.h"
+#include <thread>
+#include <mutex>
+
+ConcurrentDnaDb::ConcurrentDnaDb(uint64_t size, hash_fn hash, TABLE_MODE mode, unsigned shards)
+        :m_shards(nullptr), m_numShards(1), m_shardShift(64)
+{
+    if (shards == 0) {
+        shards = max(1u, std::thread::hardware_concurrency()) * SHARDSPERTHREAD;
+    }
+    shards = min(shards, MAXSHARDS);
+    while (m_numShards < shards) {  //round up to a power of two
+        m_numShards *= 2;
+        m_shardShift--;
+    }
+    m_shards = new Shard[m_numShards];
+    for (unsigned i = 0; i < m_numShards; i++) {
+        m_shards[i].db = new DnaDb(size / m_numShards, hash, mode);
+    }
+}
+
+ConcurrentDnaDb::~ConcurrentDnaDb() {
+    for (unsigned i = 0; i < m_numShards; i++) {
+        delete m_shards[i].db;
+    }
+    delete[] m_shards;
+}
+
+ConcurrentDnaDb::Shard& ConcurrentDnaDb::shard_of(uint64_t hash) const {
+    //the shard comes from the top bits of a Fibonacci multiply, the shard
+    //tables index with the low bits or a prime modulus, so the two stay
+    //independent
+    if (m_numShards == 1) {
+        return m_shards[0];
+    }
+    return m_shards[(hash * 0x9E3779B97F4A7C15ULL) >> m_shardShift];
+}
+
+// Every shard hashes the same way, so the key is hashed once, by the first
+// shard's DnaDb. Its hash then picks the shard and travels with the key
+// into that shard's table, which does not hash it again.
+DnaDb::KeyRef ConcurrentDnaDb::key_of(const DNA& dna) const {
+    return m_shards[0].db->key_of(dna);
+}
+
+DnaDb::KeyRef ConcurrentDnaDb::key_of(string_view sequence, int location) const {
+    return m_shards[0].db->key_of(sequence, location);
+}
+
+bool ConcurrentDnaDb::insert(const DNA& dna) {
+    DnaDb::KeyRef key = key_of(dna);
+    Shard& shard = shard_of(key.hash);
+    std::unique_lock<std::shared_mutex> guard(shard.lock);
+    return shard.db->insert_key(dna, key);
+}
+
+bool ConcurrentDnaDb::emplace(string_view sequence, int location) {
+    DnaDb::KeyRef key = key_of(sequence, location);
+    Shard& shard = shard_of(key.hash);
+    std::unique_lock<std::shared_mutex> guard(shard.lock);
+    std::unique_lock<std::mutex> writes = shard.db->lock_writes();
+    return shard.db->emplace_key(key);
+}
+
+bool ConcurrentDnaDb::remove(const DNA& dna) {
+    DnaDb::KeyRef key = key_of(dna);
+    Shard& shard = shard_of(key.hash);
+    std::unique_lock<std::shared_mutex> guard(shard.lock);
+    return shard.db->remove_key(key);
+}
+
+bool ConcurrentDnaDb::contains(string_view sequence, int location) const {
+    //DnaDb::find does not modify the table, so any number of readers can
+    //share a shard
+    if (location < MINLOCID || location > MAXLOCID) { //if bad location id
+        return false;
+    }
+    DnaDb::KeyRef key = key_of(sequence, location);
+    Shard& shard = shard_of(key.hash);
+    std::shared_lock<std::shared_mutex> guard(shard.lock);
+    return shard.db->find_key(key) != nullptr;
+}
+
+DNA ConcurrentDnaDb::getDNA(string_view sequence, int location) const {
+    if (location < MINLOCID || location > MAXLOCID) { //if bad location id
+        return EMPTY;
+    }
+    DnaDb::KeyRef key = key_of(sequence, location);
+    Shard& shard = shard_of(key.hash);
+    std::shared_lock<std::shared_mutex> guard(shard.lock);
+    return shard.db->get_key(key);
+}
+
+uint64_t ConcurrentDnaDb::capacity() const {
+    uint64_t total = 0;
+    for (unsigned i = 0; i < m_numShards; i++) {
+        std::shared_lock<std::shared_mutex> guard(m_shards[i].lock);
+        total += m_shards[i].db->capacity();
+    }
+    return total;
+}
@@ -0,0 +1,50 @@
+#ifndef CONCURRENTDNADB_H
+#define CONCURRENTDNADB_H
+#include "dnadb.h"
+#include <shared_mutex>
+
+const unsigned MAXSHARDS = 1024;    // upper bound on the shard count
+const unsigned SHARDSPERTHREAD = 4; // default shards per hardware thread
+
+// A DnaDb that many threads can share. Keys are hash partitioned over a
+// power-of-two number of shards, each an independent DnaDb (so each grows
+// and rehashes on its own) behind its own reader/writer lock. Lookups only
+// take their shard's lock in shared mode, so readers never contend with
+// each other and writers only with operations on the same shard.
+class ConcurrentDnaDb{
+public:
+    friend class Tester;
+    // shards == 0 picks SHARDSPERTHREAD shards per hardware thread. size is
+    // the total initial capacity, split evenly over the shards.
+    ConcurrentDnaDb(uint64_t size, hash_fn hash, TABLE_MODE mode = TABLE_MODE::PRIME,
+                    unsigned shards = 0);
+    ~ConcurrentDnaDb();
+    ConcurrentDnaDb(const ConcurrentDnaDb&) = delete;
+    ConcurrentDnaDb& operator=(const ConcurrentDnaDb&) = delete;
+    bool insert(const DNA& dna);
+    bool emplace(string_view sequence, int location);
+    bool remove(const DNA& dna);
+    // There is no pointer returning find: another thread may rehash the
+    // shard as soon as its lock is released, so lookups copy.
+    bool contains(string_view sequence, int location) const;
+    DNA getDNA(string_view sequence, int location) const;
+    // Number of shards and the sum of their capacities
+    unsigned shards() const { return m_numShards; }
+    uint64_t capacity() const;
+
+private:
+    // one cache line per lock so shards do not false share
+    struct alignas(64) Shard {
+        mutable std::shared_mutex   lock;
+        DnaDb*                      db;
+    };
+    Shard*      m_shards;
+    unsigned    m_numShards;    // power of two
+    unsigned    m_shardShift;   // 64 - log2(m_numShards)
+
+    Shard& shard_of(uint64_t hash) const;
+    DnaDb::KeyRef key_of(const DNA& dna) const;
+    DnaDb::KeyRef key_of(string_view sequence, int location) const;
+};
+
+#endif
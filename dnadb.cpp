@@ -1,35 +1,204 @@
 #include "dnadb.h"
-DnaDb::DnaDb(int size, hash_fn hash)
-        :m_hash(hash), m_currentTable(nullptr), m_currentCap(0), m_currentSize(0), m_currNumDeleted(0),
-         m_oldTable(nullptr), m_oldCap(0), m_oldSize(0), m_oldNumDeleted(0),
-         rehash_status(REHASH_STATUS::NOT_REHASHING)
+#include "hashtable.h"
+#include <cstring>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <memory>
+#ifdef DNADB_STATS
+#include <chrono>
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#ifdef DNADB_STATS
+// slots probed by this thread's lookup in progress, see find_slot()
+static thread_local uint64_t t_probes = 0;
+
+static uint64_t stat_nanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#endif
+
+// Slot arrays are raw memory from a SlotAllocator, constructed in place
+template <class T>
+static T* new_slots(SlotAllocator& allocator, uint64_t count) {
+    T* slots = static_cast<T*>(allocator.allocate(count * sizeof(T)));
+    std::uninitialized_default_construct_n(slots, count);
+    return slots;
+}
+
+template <class T>
+static void delete_slots(SlotAllocator& allocator, T* slots, uint64_t count) {
+    if (slots == nullptr) {
+        return;
+    }
+    std::destroy_n(slots, count);
+    allocator.deallocate(slots, count * sizeof(T));
+}
+
+// Control tags are read with acquire and written with release ordering, so
+// a reader that sees a full tag also sees the DNA written before it. On
+// x86 these compile to plain loads and stores.
+static int8_t load_tag(const int8_t* ctrl, uint64_t index) {
+    return __atomic_load_n(&ctrl[index], __ATOMIC_ACQUIRE);
+}
+
+static void store_tag(int8_t* ctrl, uint64_t index, int8_t tag) {
+    __atomic_store_n(&ctrl[index], tag, __ATOMIC_RELEASE);
+}
+
+// One SIMD register worth of control tags, scanned together in SWISS mode.
+// Each match returns a bitmask with bit i set for slot i of the group.
+// The tags are gathered with load_tag(), not one vector load: lookups run
+// alongside the background migrator, and a plain load would let a reader
+// act on a tag without the slot the migrator published before it.
+class CtrlGroup{
+public:
+#if defined(__AVX2__)
+    static const int WIDTH = 32;
+    CtrlGroup(const int8_t* ctrl) {
+        alignas(WIDTH) int8_t tags[WIDTH];
+        acquire(tags, ctrl);
+        m_ctrl = _mm256_load_si256((const __m256i*)tags);
+    }
+    uint32_t match(int8_t tag) const {
+        return _mm256_movemask_epi8(_mm256_cmpeq_epi8(m_ctrl, _mm256_set1_epi8(tag)));
+    }
+    uint32_t matchEmptyOrDeleted() const {
+        // empty and deleted are the only tags below -1
+        return _mm256_movemask_epi8(_mm256_cmpgt_epi8(_mm256_set1_epi8(-1), m_ctrl));
+    }
+private:
+    __m256i m_ctrl;
+#elif defined(__SSE2__)
+    static const int WIDTH = 16;
+    CtrlGroup(const int8_t* ctrl) {
+        alignas(WIDTH) int8_t tags[WIDTH];
+        acquire(tags, ctrl);
+        m_ctrl = _mm_load_si128((const __m128i*)tags);
+    }
+    uint32_t match(int8_t tag) const {
+        return _mm_movemask_epi8(_mm_cmpeq_epi8(m_ctrl, _mm_set1_epi8(tag)));
+    }
+    uint32_t matchEmptyOrDeleted() const {
+        // empty and deleted are the only tags below -1
+        return _mm_movemask_epi8(_mm_cmplt_epi8(m_ctrl, _mm_set1_epi8(-1)));
+    }
+private:
+    __m128i m_ctrl;
+#else
+    static const int WIDTH = 8;
+    CtrlGroup(const int8_t* ctrl) { acquire(m_ctrl, ctrl); }
+    uint32_t match(int8_t tag) const {
+        uint32_t mask = 0;
+        for (int i = 0; i < WIDTH; i++) {
+            mask |= uint32_t(m_ctrl[i] == tag) << i;
+        }
+        return mask;
+    }
+    uint32_t matchEmptyOrDeleted() const {
+        uint32_t mask = 0;
+        for (int i = 0; i < WIDTH; i++) {
+            mask |= uint32_t(m_ctrl[i] < -1) << i;
+        }
+        return mask;
+    }
+private:
+    int8_t m_ctrl[WIDTH];
+#endif
+    static void acquire(int8_t* tags, const int8_t* ctrl) {
+        for (int i = 0; i < WIDTH; i++) {
+            tags[i] = load_tag(ctrl, i);
+        }
+    }
+public:
+    uint32_t matchEmpty() const { return match(CTRL_EMPTY); }
+};
+
+// murmur3 finalizer, spreads every input bit over the whole word
+static uint64_t mix_hash(uint64_t hash) {
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+// hashtable.h policies of the open-addressing modes. ROBIN_HOOD homes its
+// keys as POWER_OF_TWO does and probes linearly.
+typedef PowerOfTwoGrowth<> MaskGrowth;
+
+Fingerprint DnaDb::fingerprint(uint64_t hash) {
+    //the top bits of the mixed hash: the low bits pick home slots and
+    //SWISS tags, and hash_fn hashes have nothing above 32 bits unmixed
+    return Fingerprint(mix_hash(hash) >> (64 - DNADB_FINGERPRINT_BITS));
+}
+
+DnaDb::DnaDb(uint64_t size, hash_fn hash, TABLE_MODE mode)
+        :m_hash(hash), m_hashKind(HASH_KIND::PACKED), m_seed(0), m_mode(mode),
+         m_currentTable(nullptr), m_currentCap(0), m_currentSize(0), m_currNumDeleted(0), m_currentMagic(0), m_currentCtrl(nullptr),
+         m_currentPrints(nullptr), m_currentHashes(nullptr),
+         m_currentAllocator(&SlotAllocator::standard()), m_oldTable(nullptr), m_oldCap(0),
+         m_oldSize(0), m_oldNumDeleted(0), m_oldMagic(0), m_oldCtrl(nullptr), m_oldPrints(nullptr),
+         m_oldHashes(nullptr), m_oldAllocator(nullptr), m_allocator(m_currentAllocator),
+         m_migrateCursor(0), m_migrateStep(0), m_rehashBudget(REHASHBUDGET),
+         m_oldPublished(false), m_minLoad(MINLOAD), m_reserveSlots(0), m_background(false), m_stop(false), m_epoch(0), m_readers{},
+         m_statsEvery(0), m_statsWrites(0)
 {
     //done
     if (size < MINPRIME) {
         size = MINPRIME;
     }
-    else if (size > MAXPRIME) {
-        size = MAXPRIME;
-    }
-    else if (!isPrime(size)) { //if not a prime number
-        size = findNextPrime(size);
-    }
-    m_currentTable = new DNA[size];
+    size = find_capacity(size - 1, m_currentMagic); //smallest capacity >= size
+    m_currentTable = new_slots<DNA>(*m_currentAllocator, size);
+    m_currentCtrl = new_ctrl(size);
+    m_currentPrints = new_slots<Fingerprint>(*m_currentAllocator, size);
+    m_currentHashes = new_slots<uint64_t>(*m_currentAllocator, size);
     m_currentCap = size;
 }
 
+DnaDb::DnaDb(uint64_t size, HASH_KIND kind, uint64_t seed, TABLE_MODE mode)
+        :DnaDb(size, nullptr, mode)
+{
+    m_hashKind = kind;
+    m_seed = seed;
+}
+
+DnaDb::DnaDb(const DNA* entries, size_t count, hash_fn hash, TABLE_MODE mode, unsigned threads)
+        :DnaDb(uint64_t(count / mode_max_load(mode)) + 1, hash, mode)
+{
+    bulkLoad(entries, count, threads);
+}
+
 DnaDb::~DnaDb() {
     //done
+    setBackgroundRehash(false);
     if (m_currentTable != nullptr) {
-        delete[] m_currentTable; //cuz an array
+        delete_slots(*m_currentAllocator, m_currentTable, m_currentCap);
+        delete_slots(*m_currentAllocator, m_currentCtrl, m_currentCap + 1);
+        delete_slots(*m_currentAllocator, m_currentPrints, m_currentCap);
+        delete_slots(*m_currentAllocator, m_currentHashes, m_currentCap);
         m_currentTable = nullptr;
+        m_currentCtrl = nullptr;
+        m_currentPrints = nullptr;
+        m_currentHashes = nullptr;
         m_currentCap = 0;
         m_currentSize = 0;
         m_currNumDeleted = 0;
     }
     if (m_oldTable != nullptr) {
-        delete[] m_oldTable; //cuz an array
+        delete_slots(*m_oldAllocator, m_oldTable, m_oldCap);
+        delete_slots(*m_oldAllocator, m_oldCtrl, m_oldCap + 1);
+        delete_slots(*m_oldAllocator, m_oldPrints, m_oldCap);
+        delete_slots(*m_oldAllocator, m_oldHashes, m_oldCap);
         m_oldTable = nullptr;
+        m_oldCtrl = nullptr;
+        m_oldPrints = nullptr;
+        m_oldHashes = nullptr;
         m_oldCap = 0;
         m_oldSize = 0;
         m_oldNumDeleted = 0;
@@ -37,85 +206,498 @@ DnaDb::~DnaDb() {
     m_hash = nullptr;
 }
 
-bool DnaDb::insert(DNA dna) {
+bool DnaDb::insert(const DNA& dna) {
     //done
-    if (dna.m_location < MINLOCID || dna.m_location > MAXLOCID) {
-        //bad location, reject insert operation
+    return insert_key(dna, key_of(dna));
+}
+
+bool DnaDb::insert_key(const DNA& dna, const KeyRef& key) {
+    std::unique_lock<std::mutex> guard = lock_writes();
+    uint64_t index;
+    if (!claim_slot(key, index)) {
         return false;
     }
-    unsigned int index = get_index_cur(dna, true);
-    if (m_currentTable[index] == dna) {
-        //already have this DNA
+    store(index, dna.m_sequence, dna.m_location, m_currentArena);
+    commit_slot(index, key);
+    return true;
+}
+
+bool DnaDb::emplace(string_view sequence, int location) {
+    //done
+    std::unique_lock<std::mutex> guard = lock_writes();
+    return emplace_key(key_of(sequence, location));
+}
+
+bool DnaDb::emplace_key(const KeyRef& key) {
+    uint64_t index;
+    if (!claim_slot(key, index)) {
         return false;
     }
-    //else not duplicate
-    m_currentTable[index] = dna;
-    m_currentSize++;
-    if (rehash_status == REHASH_STATUS::NOT_REHASHING) {
-        if (lambda() > .5f) { //floating type of .5
-            rehash();
-        }
-    }
-    else {
-        rehash();
-    }
+    m_currentTable[index].m_sequence.assign(key.view, m_currentArena);
+    m_currentTable[index].m_location = key.location;
+    commit_slot(index, key);
     return true;
 }
 
-bool DnaDb::remove(DNA dna) {
+void DnaDb::store(uint64_t index, const PackedSeq& sequence, int location, SeqArena& arena) {
+    //a reused deleted slot still borrows its old words, assign() just
+    //drops them, the arena takes them back at the next rehash
+    m_currentTable[index].m_sequence.assign(sequence, arena);
+    m_currentTable[index].m_location = location;
+}
+
+bool DnaDb::remove(const DNA& dna) {
     //done
-    if (dna.m_location < MINLOCID || dna.m_location > MAXLOCID) { //if bad location id
-        //bad location, reject insert operation
+    return remove_key(key_of(dna));
+}
+
+bool DnaDb::remove_key(const KeyRef& key) {
+    if (key.location < MINLOCID || key.location > MAXLOCID) { //if bad location id
+        //bad location, reject remove operation
         return false;
     }
-    unsigned int index = get_index_cur(dna, false);
-    if (m_currentTable[index] == dna) {
-        m_currentTable[index] = DELETED;    // DNA is in current table
+    std::unique_lock<std::mutex> guard = lock_writes();
+    uint64_t index = get_index_cur(key, false);
+    if (m_currentCtrl[index] >= 0 && m_mode == TABLE_MODE::ROBIN_HOOD) {
+        robin_remove(index);    // DNA is in current table, no tombstone
+    }
+    else if (m_currentCtrl[index] >= 0) {
+        store_tag(m_currentCtrl, index, CTRL_DELETED);  // DNA is in current table
         m_currNumDeleted++;
     }
     else if (m_oldTable == nullptr) {
         return false;   // DNA not in any table
     }
     else {
-        index = get_index_old(dna, false);
-        if (m_oldTable[index] == dna) {
-            m_oldTable[index] = DELETED;    //DNA is in old table
+        index = get_index_old(key, false);
+        if (m_oldCtrl[index] >= 0) {
+            store_tag(m_oldCtrl, index, CTRL_DELETED);  //DNA is in old table
             m_oldNumDeleted++;
         }
         else {
             return false;   // DNA not in any table
         }
     }
-    if (rehash_status == REHASH_STATUS::NOT_REHASHING) {
-        if (deletedRatio() > .8f) { //floating type of .8
-            rehash();
+    if (m_oldTable != nullptr) {
+        if (!m_background) {
+            migrate(m_migrateStep);
         }
     }
-    else {
-        rehash();
+    else if (under_load()) {
+        rehash();   //into a smaller table
     }
+    else if (m_mode != TABLE_MODE::ROBIN_HOOD && deletedRatio() > .8f) { //floating type of .8
+        rehash();   //robin hood tables have no tombstones to clear
+    }
+    wrote();
     return true;
 }
 
-DNA DnaDb::getDNA(string sequence, int location) {
+const DNA* DnaDb::find(string_view sequence, int location) const {
+    //done
+    if (location < MINLOCID || location > MAXLOCID) { //if bad location id
+        return nullptr;
+    }
+    return find_key(key_of(sequence, location));
+}
+
+const DNA* DnaDb::find_key(const KeyRef& key) const {
+    int epoch = enter_read();
+    const DNA* dna = find_slot(key);
+    exit_read(epoch);
+    return dna;
+}
+
+DNA DnaDb::getDNA(string_view sequence, int location) const {
     //done
     if (location < MINLOCID || location > MAXLOCID) { //if bad location id
-        //bad location, reject insert operation
         return EMPTY;
     }
-    DNA target = DNA(sequence, location);
-    unsigned int index = get_index_cur(target, false);
-    if (m_currentTable[index] == target) {
-        return m_currentTable[index];
+    return get_key(key_of(sequence, location));
+}
+
+DNA DnaDb::get_key(const KeyRef& key) const {
+    //the copy is made inside the read epoch, so it is safe even if a
+    //background migration retires the old table meanwhile
+    int epoch = enter_read();
+    const DNA* dna = find_slot(key);
+    DNA result = dna != nullptr ? *dna : EMPTY;
+    exit_read(epoch);
+    return result;
+}
+
+size_t DnaDb::findMany(const string_view* sequences, const int* locations, size_t count,
+                       const DNA** results) const {
+    return find_batch([&](auto emit) {
+        for (size_t i = 0; i < count; i++) {
+            emit(i, batch_key(sequences[i], locations[i]));
+        }
+    }, [results](size_t i, const DNA* dna) { results[i] = dna; });
+}
+
+void DnaDb::getDNABatch(const string_view* sequences, const int* locations, size_t count,
+                        DNA* results) const {
+    //copies inside the read epoch, as getDNA
+    find_batch([&](auto emit) {
+        for (size_t i = 0; i < count; i++) {
+            emit(i, batch_key(sequences[i], locations[i]));
+        }
+    }, [results](size_t i, const DNA* dna) {
+        results[i] = dna != nullptr ? *dna : EMPTY;
+    });
+}
+
+// 2-bit code of a base, -1 for anything outside ALPHA
+static int base_code(char base) {
+    switch (base) {
+        case 'A': return 0;
+        case 'C': return 1;
+        case 'G': return 2;
+        case 'T': return 3;
+        default: return -1;
     }
-    if (m_oldTable == nullptr) {
-        return EMPTY;   // DNA not in any table
+}
+
+// the complement of a base is 3 - its code
+static void reverse_complement(string_view window, string& out) {
+    out.resize(window.length());
+    for (size_t i = 0; i < window.length(); i++) {
+        out[i] = ALPHA[3 - base_code(window[window.length() - 1 - i])];
     }
-    index = get_index_old(target, false);
-    if (m_oldTable[index] == target) {
-        return m_oldTable[index];
+}
+
+uint64_t DnaDb::insertKmers(string_view sequence, uint32_t k, int location, bool canonical) {
+    std::unique_lock<std::mutex> guard = lock_writes();
+    string reversed;
+    uint64_t inserted = 0;
+    walk_kmers(sequence, k, canonical, [&](size_t start, uint64_t hash, bool flip) {
+        string_view window = sequence.substr(start, k);
+        if (flip) {
+            reverse_complement(window, reversed);
+            window = reversed;
+        }
+        inserted += emplace_key(KeyRef{nullptr, window, location, hash});
+    });
+    return inserted;
+}
+
+size_t DnaDb::findKmers(string_view sequence, uint32_t k, int location, const DNA** results,
+                        bool canonical) const {
+    if (k == 0 || sequence.length() < k) {
+        return 0;
+    }
+    //windows that are never emitted (bases outside ALPHA) stay nullptr
+    fill(results, results + sequence.length() - k + 1, nullptr);
+    //a flipped window is probed up to BATCHWINDOW keys after it was
+    //emitted, so its buffer is only reused twice that many keys later
+    string reversed[2 * BATCHWINDOW];
+    size_t emitted = 0;
+    return find_batch([&](auto emit) {
+        walk_kmers(sequence, k, canonical, [&](size_t start, uint64_t hash, bool flip) {
+            string_view window = sequence.substr(start, k);
+            if (flip) {
+                string& buffer = reversed[emitted % (2 * BATCHWINDOW)];
+                reverse_complement(window, buffer);
+                window = buffer;
+            }
+            emitted++;
+            emit(start, KeyRef{nullptr, window, location, hash});
+        });
+    }, [results](size_t i, const DNA* dna) { results[i] = dna; });
+}
+
+template <class Visit>
+void DnaDb::walk_kmers(string_view sequence, uint32_t k, bool canonical, Visit visit) const {
+    //visit(start, hash, flip) for every window of k bases in ALPHA, flip
+    //set when the key is the window's reverse complement. Of the two the
+    //canonical key is the one with the smaller hash (the forward window
+    //on a tie), which needs no comparison of the bases.
+    if (k == 0 || sequence.length() < k) {
+        return;
+    }
+    if (m_hash != nullptr || m_hashKind != HASH_KIND::ROLLING) {
+        //no rolling hash to slide, each window is hashed in place
+        string reversed;
+        for (size_t start = 0, run = 0; start < sequence.length(); start++) {
+            run = base_code(sequence[start]) < 0 ? 0 : run + 1;
+            if (run < k) {
+                continue;
+            }
+            string_view window = sequence.substr(start + 1 - k, k);
+            uint64_t hash = key_of(window, MINLOCID).hash;
+            bool flip = false;
+            if (canonical) {
+                reverse_complement(window, reversed);
+                uint64_t reverseHash = key_of(reversed, MINLOCID).hash;
+                flip = reverseHash < hash;
+                hash = min(hash, reverseHash);
+            }
+            visit(start + 1 - k, hash, flip);
+        }
+        return;
+    }
+    //the forward polynomial slides right as usual, the reverse complement
+    //one takes each new base's complement at its front and drops the
+    //oldest base's complement from its back
+    RollingHash forward(m_seed), reverse(m_seed);
+    uint64_t outPower = forward.power(k - 1);
+    uint64_t baseInverse = forward.inverse();
+    uint64_t frontPower = 1;    //power(run), up to power(k - 1)
+    size_t run = 0;
+    for (size_t i = 0; i < sequence.length(); i++) {
+        int code = base_code(sequence[i]);
+        if (code < 0) {
+            forward.reset();
+            reverse.reset();
+            frontPower = 1;
+            run = 0;
+            continue;
+        }
+        if (run == k) {
+            int old = base_code(sequence[i - k]);
+            forward.drop(old + 1, outPower);
+            if (canonical) {
+                reverse.dropBack(3 - old + 1, baseInverse);
+            }
+            run--;
+        }
+        forward.push(code + 1);
+        if (canonical) {
+            reverse.pushFront(3 - code + 1, frontPower);
+        }
+        run++;
+        if (run < k) {
+            frontPower = RollingHash::mul(frontPower, forward.base());
+        }
+        if (run == k) {
+            uint64_t hash = RollingHash::finish(forward.poly(), k, true);
+            bool flip = false;
+            if (canonical) {
+                uint64_t reverseHash = RollingHash::finish(reverse.poly(), k, true);
+                flip = reverseHash < hash;
+                hash = min(hash, reverseHash);
+            }
+            visit(i + 1 - k, hash, flip);
+        }
+    }
+}
+
+DnaDb::KeyRef DnaDb::batch_key(string_view sequence, int location) const {
+    if (location < MINLOCID || location > MAXLOCID) { //if bad location id
+        return KeyRef{nullptr, string_view(), location, 0};    //never hashed or probed
+    }
+    return key_of(sequence, location);
+}
+
+template <class Produce, class Visit>
+size_t DnaDb::find_batch(Produce produce, Visit visit) const {
+    //a ring of hashed keys: a key is prefetched when it enters the ring and
+    //probed BATCHWINDOW keys later, when its slots should be in cache
+    KeyRef ring[BATCHWINDOW];
+    size_t ids[BATCHWINDOW];
+    size_t pushed = 0;
+    size_t found = 0;
+    auto probe = [&](size_t slot) {
+        const KeyRef& key = ring[slot];
+        const DNA* dna = nullptr;
+        if (key.location >= MINLOCID && key.location <= MAXLOCID) {
+            dna = find_slot(key);
+        }
+        found += dna != nullptr;
+        visit(ids[slot], dna);
+    };
+    int epoch = enter_read();
+    produce([&](size_t id, const KeyRef& key) {
+        size_t slot = pushed % BATCHWINDOW;
+        if (pushed >= BATCHWINDOW) {
+            probe(slot);
+        }
+        ring[slot] = key;
+        ids[slot] = id;
+        if (key.location >= MINLOCID && key.location <= MAXLOCID) { //bad ones are never probed
+            prefetch(key);
+        }
+        pushed++;
+    });
+    for (size_t i = pushed > BATCHWINDOW ? pushed - BATCHWINDOW : 0; i < pushed; i++) {
+        probe(i % BATCHWINDOW);
+    }
+    exit_read(epoch);
+    return found;
+}
+
+void DnaDb::prefetch(const KeyRef& key) const {
+    //the first probed tag and entry in both tables, most probes end there
+    uint64_t index = probe_start(key.hash, m_currentCap, m_currentMagic);
+    __builtin_prefetch(&m_currentCtrl[index]);
+    __builtin_prefetch(&m_currentTable[index]);
+    __builtin_prefetch(&m_currentPrints[index]);
+    if (__atomic_load_n(&m_oldPublished, __ATOMIC_SEQ_CST)) {
+        index = probe_start(key.hash, m_oldCap, m_oldMagic);
+        __builtin_prefetch(&m_oldCtrl[index]);
+        __builtin_prefetch(&m_oldTable[index]);
+        __builtin_prefetch(&m_oldPrints[index]);
+    }
+}
+
+uint64_t DnaDb::probe_start(uint64_t hash, uint64_t cap, uint128_t magic) const {
+    if (m_mode == TABLE_MODE::SWISS) {
+        //first slot of the home group, see get_index_swiss()
+        uint64_t groups = cap / CtrlGroup::WIDTH;
+        return ((mix_hash(hash) >> 7) & (groups - 1)) * CtrlGroup::WIDTH;
+    }
+    if (m_mode == TABLE_MODE::PRIME) {
+        return PrimeGrowth::home(hash, cap, magic);
+    }
+    return MaskGrowth::home(hash, cap, magic);
+}
+
+// runs body(t) for every t below threads, t = 0 on the calling thread
+template <class Body>
+static void run_threads(unsigned threads, Body body) {
+    vector<std::thread> workers;
+    for (unsigned t = 1; t < threads; t++) {
+        workers.emplace_back(body, t);
+    }
+    body(0);
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+uint64_t DnaDb::bulkLoad(const DNA* entries, size_t count, unsigned threads) {
+    std::unique_lock<std::mutex> guard = lock_writes();
+    if (m_oldTable != nullptr) {
+        migrate(m_oldCap);
+    }
+    //one resize to the final size instead of a rehash per doubling
+    uint64_t live = m_currentSize - m_currNumDeleted;
+    if (float(m_currentSize + count) / float(m_currentCap) > max_load()) {
+        swap_tables(uint64_t((live + count) / max_load()) + 1);
+        migrate(m_oldCap);
+    }
+    threads = max(1u, threads);
+    KeyRef* keys = new KeyRef[count];
+    vector<uint64_t> inserted(threads);
+    vector<SeqArena> arenas(threads);   //one per thread, no locking
+    //hashing is the expensive part, split it over the entries...
+    run_threads(threads, [&](unsigned t) {
+        for (size_t i = count * t / threads; i < count * (t + 1) / threads; i++) {
+            keys[i] = key_of(entries[i]);
+        }
+    });
+    //...and the filling over the slots, so a key is always filled by the
+    //thread that owns its first probe, duplicates included. Robin hood
+    //inserts move other keys around, those are filled on this thread.
+    if (m_mode == TABLE_MODE::ROBIN_HOOD) {
+        threads = 1;
+    }
+    run_threads(threads, [&](unsigned t) {
+        bulk_fill(entries, keys, count, uint64_t(uint128_t(m_currentCap) * t / threads),
+                  uint64_t(uint128_t(m_currentCap) * (t + 1) / threads), arenas[t], inserted[t]);
+    });
+    delete[] keys;
+    uint64_t total = 0;
+    for (unsigned t = 0; t < threads; t++) {
+        total += inserted[t];
+        m_currentArena.absorb(arenas[t]);
+    }
+    m_currentSize += total;
+    wrote();
+    return total;
+}
+
+void DnaDb::bulk_fill(const DNA* entries, const KeyRef* keys, size_t count,
+                      uint64_t first, uint64_t last, SeqArena& arena, uint64_t& inserted) {
+    inserted = 0;
+    for (size_t i = 0; i < count; i++) {
+        const KeyRef& key = keys[i];
+        if (key.location < MINLOCID || key.location > MAXLOCID) {
+            continue;   //bad location, as insert rejects it
+        }
+        uint64_t start = probe_start(key.hash, m_currentCap, m_currentMagic);
+        if (start < first || start >= last) {
+            continue;
+        }
+        uint64_t index = m_mode == TABLE_MODE::ROBIN_HOOD ? robin_claim(key) : bulk_claim(key);
+        if (index == m_currentCap) {
+            continue;   //duplicate
+        }
+        store(index, entries[i].m_sequence, entries[i].m_location, arena);
+        m_currentPrints[index] = fingerprint(key.hash);
+        m_currentHashes[index] = key.hash;
+        store_tag(m_currentCtrl, index, ctrl_tag(key.hash));
+        inserted++;
+    }
+}
+
+// CAS of a slot's tag from CTRL_EMPTY to CTRL_BUSY, false if another
+// thread got there first
+static bool claim_empty(int8_t* ctrl, uint64_t index) {
+    int8_t expected = CTRL_EMPTY;
+    return __atomic_compare_exchange_n(&ctrl[index], &expected, CTRL_BUSY, false,
+                                       __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+uint64_t DnaDb::bulk_claim(const KeyRef& key) {
+    //Claims the first empty slot on the key's probe sequence by a CAS from
+    //CTRL_EMPTY to CTRL_BUSY, or returns m_currentCap if the key is there
+    //already. Other threads only ever hold different keys, so a busy slot
+    //is simply skipped. Deleted slots are not reused.
+    int8_t tag = ctrl_tag(key.hash);
+    Fingerprint print = fingerprint(key.hash);
+    if (m_mode == TABLE_MODE::SWISS) {
+        //the group order of get_index_swiss(), which stops at the first
+        //group holding an empty slot, so the key must land by then
+        uint64_t groups = m_currentCap / CtrlGroup::WIDTH;
+        uint64_t group = probe_start(key.hash, m_currentCap, m_currentMagic) / CtrlGroup::WIDTH;
+        for (uint64_t step = 1; ; step++) {
+            uint64_t base = group * CtrlGroup::WIDTH;
+            bool hasEmpty = true;
+            while (hasEmpty) {
+                hasEmpty = false;
+                for (uint64_t index = base; index < base + CtrlGroup::WIDTH; index++) {
+                    int8_t current = load_tag(m_currentCtrl, index);
+                    if (current == tag && m_currentPrints[index] == print &&
+                        matches(m_currentTable[index], key)) {
+                        return m_currentCap;
+                    }
+                    if (current == CTRL_EMPTY) {
+                        if (claim_empty(m_currentCtrl, index)) {
+                            return index;
+                        }
+                        hasEmpty = true;    //lost it, look at the group again
+                    }
+                }
+            }
+            group = (group + step) & (groups - 1);
+        }
+    }
+    if (m_mode == TABLE_MODE::PRIME) {
+        return bulk_claim_probe<QuadraticProbe, PrimeGrowth>(key);
+    }
+    return bulk_claim_probe<QuadraticProbe, MaskGrowth>(key);
+}
+
+template <class Probe, class Growth>
+uint64_t DnaDb::bulk_claim_probe(const KeyRef& key) {
+    Fingerprint print = fingerprint(key.hash);
+    uint64_t index = Growth::home(key.hash, m_currentCap, m_currentMagic);
+    uint64_t step = 1;
+    while (true) {
+        int8_t current = load_tag(m_currentCtrl, index);
+        if (current == CTRL_EMPTY) {
+            if (claim_empty(m_currentCtrl, index)) {
+                return index;
+            }
+            continue;   //lost it, read the slot again
+        }
+        if (current == CTRL_FULL && m_currentPrints[index] == print &&
+            matches(m_currentTable[index], key)) {
+            return m_currentCap;
+        }
+        Probe::next(index, step, m_currentCap);
     }
-    return EMPTY;
 }
 
 float DnaDb::lambda() const {
@@ -137,68 +719,176 @@ float DnaDb::deletedRatio() const {
     return float(m_currNumDeleted) / m_currentSize;
 }
 
+void DnaDb::setRehashBudget(uint64_t slots) {
+    //done
+    m_rehashBudget = max<uint64_t>(1, slots);
+    if (m_oldTable != nullptr) {
+        m_migrateStep = max(m_migrateStep, m_rehashBudget);
+    }
+}
+
+void DnaDb::setBackgroundRehash(bool enabled) {
+    //done
+    if (enabled == m_background || m_mode == TABLE_MODE::ROBIN_HOOD) {
+        return;
+    }
+    finishRehash();
+    if (enabled) {
+        m_stop = false;
+        m_background = true;
+        m_migrator = std::thread(&DnaDb::migrate_worker, this);
+    }
+    else {
+        {
+            std::lock_guard<std::mutex> guard(m_lock);
+            m_stop = true;
+        }
+        m_wake.notify_all();
+        m_migrator.join();
+        m_background = false;
+    }
+}
+
+void DnaDb::finishRehash() {
+    //done
+    std::unique_lock<std::mutex> guard = lock_writes();
+    if (m_background) {
+        m_done.wait(guard, [this] { return m_oldTable == nullptr; });
+    }
+    else if (m_oldTable != nullptr) {
+        migrate(m_oldCap);
+    }
+}
+
+void DnaDb::setMinLoad(float load) {
+    //done
+    m_minLoad = max(0.0f, load);
+}
+
+void DnaDb::reserve(uint64_t entries) {
+    //done
+    std::unique_lock<std::mutex> guard = lock_writes();
+    if (m_oldTable != nullptr) {
+        migrate(m_oldCap);
+    }
+    //as in commit_slot(), there has to be room for one more insert
+    m_reserveSlots = uint64_t(double(entries + 1) / max_load()) + 1;
+    if (over_load(entries + 1)) {
+        swap_tables(m_reserveSlots);
+        migrate(m_oldCap);
+    }
+}
+
+bool DnaDb::shrinkToFit() {
+    //done
+    std::unique_lock<std::mutex> guard = lock_writes();
+    if (m_oldTable != nullptr) {
+        migrate(m_oldCap);
+    }
+    m_reserveSlots = 0;
+    uint64_t live = m_currentSize - m_currNumDeleted;
+    uint128_t magic;
+    bool smaller = find_capacity(rehash_size(live), magic) < m_currentCap;
+    if (!smaller && m_currNumDeleted == 0) {
+        return false;
+    }
+    //all at once rather than a few slots per write, the point is to free
+    //the old table now
+    swap_tables(rehash_size(live));
+    DNADB_STAT(m_stats.shrinks.fetch_add(smaller, std::memory_order_relaxed));
+    migrate(m_oldCap);
+    return true;
+}
+
+void DnaDb::setSlotAllocator(SlotAllocator* allocator) {
+    //done
+    std::unique_lock<std::mutex> guard = lock_writes();
+    if (m_oldTable != nullptr) {
+        migrate(m_oldCap);
+    }
+    m_allocator = allocator != nullptr ? allocator : &SlotAllocator::standard();
+    if (m_allocator != m_currentAllocator) {
+        //a rehash at the same capacity copies every entry across
+        swap_tables(m_currentCap - 1);
+        migrate(m_oldCap);
+    }
+}
+
+uint64_t DnaDb::capacity() const {
+    //done
+    return m_currentCap;
+}
+
+uint64_t DnaDb::arenaBytes() const {
+    return m_currentArena.bytes() + m_oldArena.bytes();
+}
+
 void DnaDb::dump() const {
     //done
     cout << "Dump for current table: " << endl;
     if (m_currentTable != nullptr)
-        for (int i = 0; i < m_currentCap; i++) {
-            cout << "[" << i << "] : " << m_currentTable[i] << endl;
+        for (uint64_t i = 0; i < m_currentCap; i++) {
+            cout << "[" << i << "] : ";
+            if (m_currentCtrl[i] >= 0) {
+                cout << m_currentTable[i];
+            }
+            else if (m_currentCtrl[i] == CTRL_DELETED) {
+                cout << "DELETED";
+            }
+            cout << endl;
         }
     cout << "Dump for old table: " << endl;
     if (m_oldTable != nullptr)
-        for (int i = 0; i < m_oldCap; i++) {
-            cout << "[" << i << "] : " << m_oldTable[i] << endl;
+        for (uint64_t i = 0; i < m_oldCap; i++) {
+            cout << "[" << i << "] : ";
+            if (m_oldCtrl[i] >= 0) {
+                cout << m_oldTable[i];
+            }
+            else if (m_oldCtrl[i] == CTRL_DELETED) {
+                cout << "DELETED";
+            }
+            cout << endl;
         }
 }
 
-bool DnaDb::isPrime(int number) {
+uint64_t DnaDb::findNextPrime(uint64_t current) {
     //done
-    bool result = true;
-    for (int i = 2; i <= number / 2; ++i) {
-        if (number % i == 0) {
-            result = false;
-            break;
-        }
-    }
-    return result;
+    //the table runs from MINPRIME to MAXPRIME so no trial division is needed
+    return PRIMETABLE[prime_index(current)].prime;
 }
 
-int DnaDb::findNextPrime(int current) {
-    //done
-    //we always stay within the range [MINPRIME-MAXPRIME]
-    //the smallest prime starts at MINPRIME
-    if (current < MINPRIME) current = MINPRIME - 1;
-    for (int i = current; i < MAXPRIME; i++) {
-        for (int j = 2; j * j <= i; j++) {
-            if (i % j == 0)
-                break;
-            else if (j + 1 > sqrt(i) && i != current) {
-                return i;
-            }
+uint64_t DnaDb::find_capacity(uint64_t current, uint128_t& magic) const {
+    //returns the first capacity above current for this mode
+    if (m_mode != TABLE_MODE::PRIME) {
+        uint64_t cap = 1;
+        while (cap <= current || cap < MINPRIME) {
+            cap <<= 1;
         }
+        magic = 0;
+        return cap;
     }
-    //if a user tries to go over MAXPRIME
-    return MAXPRIME;
+    const PrimeEntry& entry = PRIMETABLE[prime_index(current)];
+    magic = entry.magic;
+    return entry.prime;
 }
 
-DNA::DNA(string sequence, int location) {
+DNA::DNA(string_view sequence, int location) {
     //done
-    if ((location >= MINLOCID && location <= MAXLOCID) ||
-        (location == 0 && sequence == "DELETED")) {
-        // this is a normal or a DELETED object
+    if (location >= MINLOCID && location <= MAXLOCID) {
+        // this is a normal object
         m_sequence = sequence;
         m_location = location;
     }
     else {
         // this is the empty object
-        m_sequence = "";
+        m_sequence = PackedSeq();
         m_location = 0;
     }
 }
 
 string DNA::getSequence() const {
     //done
-    return m_sequence;
+    return m_sequence.toString();
 }
 
 int DNA::getLocId() const {
@@ -215,12 +905,20 @@ const DNA& DNA::operator=(const DNA& rhs) {
     return *this;
 }
 
+const DNA& DNA::operator=(DNA&& rhs) noexcept {
+    if (this != &rhs) {
+        m_sequence = std::move(rhs.m_sequence);
+        m_location = rhs.m_location;
+    }
+    return *this;
+}
+
 // Overloaded insertion operator.  Prints DNA's sequence (key),
 // and the location ID. This is a friend function in DNA class.
 ostream& operator<<(ostream& sout, const DNA& dna) {
     //done
     if (!dna.m_sequence.empty())
-        sout << dna.m_sequence << " (Location ID " << dna.m_location << ")";
+        sout << dna.m_sequence.toString() << " (Location ID " << dna.m_location << ")";
     else
         sout << "";
     return sout;
@@ -233,91 +931,965 @@ bool operator==(const DNA& lhs, const DNA& rhs) {
     return ((lhs.m_sequence == rhs.m_sequence) && (lhs.m_location == rhs.m_location));
 }
 
-unsigned int DnaDb::get_index_cur(DNA dna, bool deleted_empty) const {
-    //done
-    unsigned int index = m_hash(dna.getSequence()) % m_currentCap;
-    unsigned int temp = 1;
-    while (!(m_currentTable[index] == dna)) {   // as long as DNA object in table is not
-        // what were searching for
-        if (m_currentTable[index] == EMPTY) {
-            break;
+DnaDb::KeyRef DnaDb::key_of(const DNA& dna) const {
+    KeyRef key{&dna.m_sequence, string_view(), dna.m_location, 0};
+    if (m_hash == nullptr) {
+        key.hash = dna.m_sequence.hash(m_hashKind, m_seed);   // packed key mode
+    }
+    else {
+        key.hash = m_hash(dna.getSequence());
+    }
+    return key;
+}
+
+DnaDb::KeyRef DnaDb::key_of(string_view sequence, int location) const {
+    KeyRef key{nullptr, sequence, location, 0};
+    if (m_hash == nullptr) {
+        key.hash = PackedSeq::hash(sequence, m_hashKind, m_seed);   // packed key mode
+    }
+    else {
+        key.hash = m_hash(sequence);
+    }
+    return key;
+}
+
+bool DnaDb::matches(const DNA& slot, const KeyRef& key) const {
+    if (slot.m_location != key.location) {
+        return false;
+    }
+    if (key.packed != nullptr) {
+        return slot.m_sequence == *key.packed;
+    }
+    return slot.m_sequence.equals(key.view);
+}
+
+bool DnaDb::claim_slot(const KeyRef& key, uint64_t& index) {
+    //finds the slot an insert goes to, false if the key is not insertable
+    if (key.location < MINLOCID || key.location > MAXLOCID) {
+        //bad location, reject insert operation
+        return false;
+    }
+    //an entry still waiting in the old table counts as a duplicate too
+    if (m_oldTable != nullptr && m_oldCtrl[get_index_old(key, false)] >= 0) {
+        return false;
+    }
+    if (m_mode == TABLE_MODE::ROBIN_HOOD) {
+        index = robin_claim(key);
+        return index != m_currentCap;
+    }
+    index = get_index_cur(key, true);
+    //a full slot means we already have this DNA
+    return m_currentCtrl[index] < 0;
+}
+
+void DnaDb::commit_slot(uint64_t index, const KeyRef& key) {
+    //marks a freshly written slot full and keeps the rehash going. A
+    //reused deleted slot was counted in m_currentSize already.
+    bool reused = m_currentCtrl[index] == CTRL_DELETED;
+    m_currentPrints[index] = fingerprint(key.hash);
+    m_currentHashes[index] = key.hash;
+    store_tag(m_currentCtrl, index, ctrl_tag(key.hash));
+    if (reused) {
+        m_currNumDeleted--;
+    }
+    else {
+        m_currentSize++;
+    }
+    if (m_oldTable != nullptr) {
+        //the step is sized to finish in time, draining the rest here only
+        //happens if the budget was changed mid migration. A background
+        //migrator has no step, so drain before the entries it still has
+        //to move could overfill the new table.
+        uint64_t pending = m_background ? m_oldSize - m_oldNumDeleted : 0;
+        if (over_load(m_currentSize + pending + 1)) {
+            migrate(m_oldCap);
+        }
+        else if (!m_background) {
+            migrate(m_migrateStep);
+        }
+    }
+    //rehash while there is still room for the next insert, an old table
+    //has to keep an empty slot on every probe sequence
+    if (m_oldTable == nullptr && over_load(m_currentSize + 1)) {
+        rehash();
+    }
+    wrote();
+}
+
+bool DnaDb::over_load(uint64_t slots) const {
+    //true if slots non-empty slots would be too many for the current table
+    if (m_mode == TABLE_MODE::PRIME) {
+        //triangular probing only reaches (cap + 1) / 2 slots, so past this
+        //an unlucky probe sequence (e.g. one key at many locations) could
+        //find every one of them taken
+        return slots > (m_currentCap - 1) / 2;
+    }
+    return float(slots) / float(m_currentCap) > max_load();
+}
+
+float DnaDb::max_load() const {
+    return mode_max_load(m_mode);
+}
+
+float DnaDb::mode_max_load(TABLE_MODE mode) {
+    //control tags make probing cheap enough to run swiss tables fuller,
+    //and robin hood ordering keeps the probes of a full table short
+    if (mode == TABLE_MODE::SWISS) {
+        return SWISSMAXLOAD;
+    }
+    return mode == TABLE_MODE::ROBIN_HOOD ? ROBINMAXLOAD : MAXLOAD;
+}
+
+int8_t* DnaDb::new_ctrl(uint64_t cap) const {
+    //one more tag past the end, always empty: a ROBIN_HOOD miss returns
+    //cap, which then reads as an empty slot
+    int8_t* ctrl = new_slots<int8_t>(*m_currentAllocator, cap + 1);
+    memset(ctrl, CTRL_EMPTY, cap + 1);
+    return ctrl;
+}
+
+int8_t DnaDb::ctrl_tag(uint64_t hash) const {
+    if (m_mode != TABLE_MODE::SWISS) {
+        return CTRL_FULL;   // only swiss probing reads the hash bits
+    }
+    return int8_t(mix_hash(hash) & 0x7F);
+}
+
+uint64_t DnaDb::get_index_swiss(const DNA* table, const int8_t* ctrl, const Fingerprint* prints,
+                                uint64_t cap, const KeyRef& key, bool deleted_empty) const {
+    //returns the slot holding dna, otherwise the first free slot on its
+    //probe sequence (empty, or empty/deleted when deleted_empty is set)
+    //the low 7 bits of the mixed hash are the tag, the rest pick the group
+    uint64_t hash = mix_hash(key.hash);
+    int8_t tag = int8_t(hash & 0x7F);
+    Fingerprint print = fingerprint(key.hash);
+    uint64_t groups = cap / CtrlGroup::WIDTH;
+    uint64_t group = (hash >> 7) & (groups - 1);
+    uint64_t freeSlot = cap;
+    for (uint64_t step = 1; ; step++) {
+        uint64_t base = group * CtrlGroup::WIDTH;
+        CtrlGroup tags(ctrl + base);
+        for (uint32_t match = tags.match(tag); match != 0; match &= match - 1) {
+            // only touch the full key when the tag and fingerprint match
+            uint64_t index = base + __builtin_ctz(match);
+            if (prints[index] == print && matches(table[index], key)) {
+                return index;
+            }
         }
-        if (deleted_empty && m_currentTable[index] == DELETED) {
-            break;
+        uint32_t empty = tags.matchEmpty();
+        if (freeSlot == cap) {
+            uint32_t free = deleted_empty ? tags.matchEmptyOrDeleted() : empty;
+            if (free != 0) {
+                freeSlot = base + __builtin_ctz(free);
+            }
+        }
+        if (empty != 0) {
+            return freeSlot;   // an empty slot ends every probe sequence
         }
-        //Quadratic Probing
-        index += temp;
-        index %= m_currentCap;
-        temp += 2;
-        temp %= m_currentCap;
+        //Triangular Probing over groups
+        group = (group + step) & (groups - 1);
+        DNADB_STAT(t_probes++);
     }
-    return index;
 }
 
-unsigned int DnaDb::get_index_old(DNA dna, bool deleted_empty) const {
+uint64_t DnaDb::get_index_robin(const DNA* table, const int8_t* ctrl, const Fingerprint* prints,
+                                const uint64_t* hashes, uint64_t cap, const KeyRef& key,
+                                uint64_t& at) const {
+    //entries sit in the order of their home slots, so the key's run ends
+    //at the first entry whose home comes after the key's. An old table's
+    //deleted slots keep their hashes, and with them their place.
+    //the stop test needs every entry's home, so robin hood probes read the
+    //full hashes as well as the fingerprints
+    uint64_t index = MaskGrowth::home(key.hash, cap, 0);
+    Fingerprint print = fingerprint(key.hash);
+    for (uint64_t probes = 0; ; probes++) {
+        int8_t tag = load_tag(ctrl, index);
+        if (tag >= 0 && prints[index] == print && matches(table[index], key)) {
+            at = index;
+            return index;
+        }
+        if (tag == CTRL_EMPTY || home_distance(hashes, index, cap) < probes) {
+            at = index;
+            return cap;
+        }
+        index = (index + 1) & (cap - 1);
+        DNADB_STAT(t_probes++);
+    }
+}
+
+uint64_t DnaDb::home_distance(const uint64_t* hashes, uint64_t index, uint64_t cap) const {
+    return (index - MaskGrowth::home(hashes[index], cap, 0)) & (cap - 1);
+}
+
+uint64_t DnaDb::robin_claim(const KeyRef& key) {
+    uint64_t at;
+    if (get_index_robin(m_currentTable, m_currentCtrl, m_currentPrints, m_currentHashes,
+                        m_currentCap, key, at) != m_currentCap) {
+        return m_currentCap;
+    }
+    //the key goes ahead of the entries homed after it, which move up one
+    //slot each as far as the first empty slot
+    uint64_t mask = m_currentCap - 1;
+    uint64_t end = at;
+    while (m_currentCtrl[end] != CTRL_EMPTY) {
+        end = (end + 1) & mask;
+    }
+    for (uint64_t i = end; i != at; ) {
+        uint64_t prev = (i - 1) & mask;
+        m_currentTable[i] = std::move(m_currentTable[prev]);
+        m_currentPrints[i] = m_currentPrints[prev];
+        m_currentHashes[i] = m_currentHashes[prev];
+        m_currentCtrl[i] = m_currentCtrl[prev];
+        i = prev;
+    }
+    m_currentCtrl[at] = CTRL_EMPTY;
+    return at;
+}
+
+void DnaDb::robin_remove(uint64_t index) {
+    //pulls each following entry that is away from home one slot back, up
+    //to an empty slot or an entry at home; no tombstone is left behind
+    uint64_t mask = m_currentCap - 1;
+    uint64_t next = (index + 1) & mask;
+    while (m_currentCtrl[next] != CTRL_EMPTY && home_distance(m_currentHashes, next, m_currentCap) != 0) {
+        m_currentTable[index] = std::move(m_currentTable[next]);
+        m_currentPrints[index] = m_currentPrints[next];
+        m_currentHashes[index] = m_currentHashes[next];
+        m_currentCtrl[index] = m_currentCtrl[next];
+        index = next;
+        next = (next + 1) & mask;
+    }
+    m_currentCtrl[index] = CTRL_EMPTY;
+    m_currentSize--;
+}
+
+uint64_t DnaDb::get_index_cur(const KeyRef& key, bool deleted_empty) const {
     //done
-    unsigned int index = m_hash(dna.getSequence()) % m_oldCap;
-    unsigned int temp = 1;
-    while (!(m_oldTable[index] == dna)) {   // as long as DNA object in table is not
-        // what were searching for
-        if (m_oldTable[index] == EMPTY) {
-            break;
+    if (m_mode == TABLE_MODE::ROBIN_HOOD) {
+        uint64_t at;    //inserts go through robin_claim()
+        return get_index_robin(m_currentTable, m_currentCtrl, m_currentPrints, m_currentHashes,
+                               m_currentCap, key, at);
+    }
+    if (m_mode == TABLE_MODE::SWISS) {
+        return get_index_swiss(m_currentTable, m_currentCtrl, m_currentPrints, m_currentCap, key,
+                               deleted_empty);
+    }
+    if (m_mode == TABLE_MODE::PRIME) {
+        return get_index_probe<QuadraticProbe, PrimeGrowth>(m_currentTable, m_currentCtrl,
+                                                            m_currentPrints, m_currentCap,
+                                                            m_currentMagic, key, deleted_empty);
+    }
+    return get_index_probe<QuadraticProbe, MaskGrowth>(m_currentTable, m_currentCtrl,
+                                                       m_currentPrints, m_currentCap,
+                                                       m_currentMagic, key, deleted_empty);
+}
+
+uint64_t DnaDb::get_index_old(const KeyRef& key, bool deleted_empty) const {
+    //done
+    if (m_mode == TABLE_MODE::ROBIN_HOOD) {
+        uint64_t at;
+        return get_index_robin(m_oldTable, m_oldCtrl, m_oldPrints, m_oldHashes, m_oldCap, key, at);
+    }
+    if (m_mode == TABLE_MODE::SWISS) {
+        return get_index_swiss(m_oldTable, m_oldCtrl, m_oldPrints, m_oldCap, key, deleted_empty);
+    }
+    if (m_mode == TABLE_MODE::PRIME) {
+        return get_index_probe<QuadraticProbe, PrimeGrowth>(m_oldTable, m_oldCtrl, m_oldPrints,
+                                                            m_oldCap, m_oldMagic, key,
+                                                            deleted_empty);
+    }
+    return get_index_probe<QuadraticProbe, MaskGrowth>(m_oldTable, m_oldCtrl, m_oldPrints,
+                                                       m_oldCap, m_oldMagic, key, deleted_empty);
+}
+
+template <class Probe, class Growth>
+uint64_t DnaDb::get_index_probe(const DNA* table, const int8_t* ctrl, const Fingerprint* prints,
+                                uint64_t cap, uint128_t magic, const KeyRef& key,
+                                bool deleted_empty) const {
+    //returns the slot holding dna, otherwise the first free slot on its
+    //probe sequence (empty, or empty/deleted when deleted_empty is set).
+    //A deleted slot does not end the probe: the key may sit further on.
+    uint64_t index = Growth::home(key.hash, cap, magic);
+    uint64_t temp = 1;
+    uint64_t freeSlot = cap;
+    Fingerprint print = fingerprint(key.hash);
+    for (int8_t tag; (tag = load_tag(ctrl, index)) != CTRL_EMPTY; ) {
+        // only full slots hold a key worth comparing
+        if (tag == CTRL_DELETED) {
+            if (deleted_empty && freeSlot == cap) {
+                freeSlot = index;
+            }
         }
-        if (deleted_empty && m_oldTable[index] == DELETED) {
-            break;
+        else if (prints[index] == print && matches(table[index], key)) {
+            return index;
         }
-        //Quadratic Probing
-        index += temp;
-        index %= m_oldCap;
-        temp += 2;
-        temp %= m_oldCap;
+        Probe::next(index, temp, cap);
+        DNADB_STAT(t_probes++);
     }
-    return index;
+    return freeSlot != cap ? freeSlot : index;
 }
 
 void DnaDb::rehash() {
     //done
-    int datapoints;
-    if (rehash_status == REHASH_STATUS::NOT_REHASHING) {
-        m_oldTable = m_currentTable;
-        m_oldCap = m_currentCap;
-        m_oldSize = m_currentSize;
-        m_currentSize = 0;
-        m_oldNumDeleted = m_currNumDeleted;
-        m_currNumDeleted = 0;
-        m_currentCap = findNextPrime(4 * (m_oldSize - m_oldNumDeleted));
-        m_currentTable = new DNA[m_currentCap];
-        datapoints = (m_oldSize - m_oldNumDeleted + 3) / 4;
-        rehash_status = REHASH_STATUS::QUARTER; //updating rehash status
+    //retires the current table and starts a new one, migrate() then moves
+    //the old entries over a few slots at a time
+    uint64_t live = m_currentSize - m_currNumDeleted;
+    DNADB_STAT(uint128_t magic);
+    DNADB_STAT(bool shrinks = find_capacity(rehash_size(live), magic) < m_currentCap);
+    swap_tables(rehash_size(live));
+    DNADB_STAT(m_stats.shrinks.fetch_add(shrinks, std::memory_order_relaxed));
+    if (m_background) {
+        m_wake.notify_all();    //the migrator takes it from here
+        return;
+    }
+    //inserts left before the new table passes max_load() once every old
+    //entry has landed in it, the step must drain the old table by then
+    uint64_t headroom = max<uint64_t>(1, uint64_t(max_load() * m_currentCap) - live);
+    m_migrateStep = max(m_rehashBudget, (m_oldCap + headroom - 1) / headroom);
+    migrate(m_migrateStep);
+}
+
+uint64_t DnaDb::rehash_size(uint64_t live) const {
+    //swiss and robin hood tables run up to 7/8 full, so doubling live
+    //entries is enough
+    return max((max_load() > MAXLOAD ? 2 : 4) * live, m_reserveSlots);
+}
+
+bool DnaDb::under_load() const {
+    //the float test first, it is all most removes pay
+    uint64_t live = m_currentSize - m_currNumDeleted;
+    if (float(live) >= m_minLoad * float(m_currentCap)) {
+        return false;
+    }
+    //rehash_size() keeps the new table at most 1/4 full (1/2 in swiss and
+    //robin hood mode), comparing capacities keeps a table whose rehash
+    //would not shrink it from rehashing after every remove
+    uint128_t magic;
+    return find_capacity(rehash_size(live), magic) < m_currentCap;
+}
+
+void DnaDb::swap_tables(uint64_t size) {
+    //the current table becomes the old one, next to a new table of at
+    //least size slots
+    DNADB_STAT(uint64_t start = stat_nanos());
+    m_oldTable = m_currentTable;
+    m_oldCtrl = m_currentCtrl;
+    m_oldPrints = m_currentPrints;
+    m_oldHashes = m_currentHashes;
+    m_oldAllocator = m_currentAllocator;
+    m_currentAllocator = m_allocator;
+    m_oldCap = m_currentCap;
+    m_oldMagic = m_currentMagic;
+    m_oldSize = m_currentSize;
+    m_currentSize = 0;
+    m_oldNumDeleted = m_currNumDeleted;
+    m_currNumDeleted = 0;
+    m_currentCap = find_capacity(size, m_currentMagic);
+    m_currentTable = new_slots<DNA>(*m_currentAllocator, m_currentCap);
+    m_currentCtrl = new_ctrl(m_currentCap);
+    m_currentPrints = new_slots<Fingerprint>(*m_currentAllocator, m_currentCap);
+    m_currentHashes = new_slots<uint64_t>(*m_currentAllocator, m_currentCap);
+    m_oldArena.absorb(m_currentArena);
+    m_migrateCursor = 0;
+    __atomic_store_n(&m_oldPublished, true, __ATOMIC_SEQ_CST);
+    DNADB_STAT(m_stats.rehashes.fetch_add(1, std::memory_order_relaxed));
+    DNADB_STAT(m_stats.swapNanos.fetch_add(stat_nanos() - start, std::memory_order_relaxed));
+}
+
+void DnaDb::migrate(uint64_t slots) {
+    //resumes at the cursor, so every old slot is visited exactly once
+    uint64_t end = min(m_oldCap, m_migrateCursor + slots);
+    DNADB_STAT(uint64_t start = stat_nanos());
+    DNADB_STAT(uint64_t moved = m_currentSize);
+    for (uint64_t j = m_migrateCursor; j < end; j++) {
+        if (m_oldCtrl[j] >= 0) {
+            //the cached hash re-indexes the entry without hashing its key
+            const DNA& entry = m_oldTable[j];
+            KeyRef key{&entry.m_sequence, string_view(), entry.m_location, m_oldHashes[j]};
+            uint64_t index = m_mode == TABLE_MODE::ROBIN_HOOD ? robin_claim(key)
+                                                              : get_index_cur(key, false);
+            //a copy into the new arena, never a move: the old words stay
+            //put for lock-free readers until retire_old() frees them, and
+            //only live keys are copied, so the new arena starts compacted
+            store(index, entry.m_sequence, entry.m_location, m_currentArena);
+            m_currentPrints[index] = m_oldPrints[j];
+            m_currentHashes[index] = key.hash;
+            //publish the new copy before hiding the old one, readers look
+            //in the old table first so they always see one of the two
+            store_tag(m_currentCtrl, index, ctrl_tag(key.hash));
+            store_tag(m_oldCtrl, j, CTRL_DELETED);
+            m_currentSize++;
+            m_oldNumDeleted++;
+        }
+    }
+    DNADB_STAT(m_stats.slotsMigrated.fetch_add(end - m_migrateCursor, std::memory_order_relaxed));
+    DNADB_STAT(m_stats.entriesMigrated.fetch_add(m_currentSize - moved, std::memory_order_relaxed));
+    DNADB_STAT(m_stats.migrateNanos.fetch_add(stat_nanos() - start, std::memory_order_relaxed));
+    m_migrateCursor = end;
+    if (m_migrateCursor == m_oldCap) {
+        retire_old();
+    }
+}
+
+void DnaDb::retire_old() {
+    //hide the old table from new readers, then wait out the readers that
+    //may still be probing it before it is freed
+    DNADB_STAT(uint64_t start = stat_nanos());
+    __atomic_store_n(&m_oldPublished, false, __ATOMIC_SEQ_CST);
+    wait_for_readers();
+    delete_slots(*m_oldAllocator, m_oldTable, m_oldCap);
+    delete_slots(*m_oldAllocator, m_oldCtrl, m_oldCap + 1);
+    delete_slots(*m_oldAllocator, m_oldPrints, m_oldCap);
+    delete_slots(*m_oldAllocator, m_oldHashes, m_oldCap);
+    m_oldArena.clear();
+    m_oldTable = nullptr;
+    m_oldCtrl = nullptr;
+    m_oldPrints = nullptr;
+    m_oldHashes = nullptr;
+    m_oldCap = 0;
+    m_oldMagic = 0;
+    m_oldNumDeleted = 0;
+    m_oldSize = 0;
+    m_migrateCursor = 0;
+    DNADB_STAT(m_stats.retireNanos.fetch_add(stat_nanos() - start, std::memory_order_relaxed));
+}
+
+void DnaDb::migrate_worker() {
+    std::unique_lock<std::mutex> guard(m_lock);
+    while (true) {
+        m_wake.wait(guard, [this] { return m_stop || m_oldTable != nullptr; });
+        if (m_stop) {
+            return;
+        }
+        //a chunk per lock hold, so a foreground writer waits for at most
+        //one chunk and never does the migration itself
+        migrate(BACKGROUNDCHUNK);
+        if (m_oldTable == nullptr) {
+            m_done.notify_all();
+        }
+        else {
+            guard.unlock();
+            std::this_thread::yield();
+            guard.lock();
+        }
     }
-    else if (rehash_status == REHASH_STATUS::QUARTER) {
-        datapoints = (m_oldSize - m_oldNumDeleted + 2) / 3;
-        rehash_status = REHASH_STATUS::HALF; //updating rehash status
+}
+
+std::unique_lock<std::mutex> DnaDb::lock_writes() {
+    //writers only need the lock while a migrator thread exists
+    std::unique_lock<std::mutex> guard(m_lock, std::defer_lock);
+    if (m_background) {
+        guard.lock();
     }
-    else if (rehash_status == REHASH_STATUS::HALF) {
-        datapoints = (m_oldSize - m_oldNumDeleted + 1) / 2;
-        rehash_status = REHASH_STATUS::THREE_QUARTER; //updating rehash status
+    return guard;
+}
+
+int DnaDb::enter_read() const {
+    //two-counter epochs: a reader registers under the current epoch's
+    //parity, and retire_old() flips the epoch and waits for the old parity
+    //to drain. Only needed while a migrator can retire tables under us.
+    if (!m_background) {
+        return -1;
+    }
+    while (true) {
+        uint64_t epoch = m_epoch.load();
+        int parity = int(epoch & 1);
+        m_readers[parity]++;
+        if (m_epoch.load() == epoch) {
+            return parity;
+        }
+        m_readers[parity]--;    //raced with a flip, register again
+    }
+}
+
+void DnaDb::exit_read(int parity) const {
+    if (parity >= 0) {
+        m_readers[parity]--;
+    }
+}
+
+void DnaDb::wait_for_readers() {
+    //readers that entered after the flip can no longer see the old table
+    int parity = int(m_epoch.fetch_add(1) & 1);
+    while (m_readers[parity].load() != 0) {
+        std::this_thread::yield();
+    }
+}
+
+const DNA* DnaDb::find_slot(const KeyRef& key) const {
+    //key.hash serves both tables, the old table goes first, see migrate()
+    //each table's probe counts its first slot, get_index_*() the rest
+    DNADB_STAT(t_probes = 0);
+    if (__atomic_load_n(&m_oldPublished, __ATOMIC_SEQ_CST)) {
+        uint64_t index = get_index_old(key, false);
+        DNADB_STAT(t_probes++);
+        if (load_tag(m_oldCtrl, index) >= 0) {
+            DNADB_STAT(count_lookup(true, true));
+            return &m_oldTable[index];
+        }
+    }
+    uint64_t index = get_index_cur(key, false);
+    DNADB_STAT(t_probes++);
+    if (load_tag(m_currentCtrl, index) >= 0) {
+        DNADB_STAT(count_lookup(true, false));
+        return &m_currentTable[index];
+    }
+    DNADB_STAT(count_lookup(false, false));
+    return nullptr;
+}
+
+#ifdef DNADB_STATS
+void DnaDb::count_lookup(bool hit, bool old) const {
+    //bucket b takes lengths in (2^(b-1), 2^b]
+    uint64_t probes = t_probes;
+    int bucket = probes <= 1 ? 0 : 64 - __builtin_clzll(probes - 1);
+    bucket = min(bucket, PROBEBUCKETS - 1);
+    if (hit) {
+        m_stats.hits.fetch_add(1, std::memory_order_relaxed);
+        (old ? m_stats.oldHits : m_stats.currentHits).fetch_add(1, std::memory_order_relaxed);
+        m_stats.hitProbes[bucket].fetch_add(1, std::memory_order_relaxed);
+        m_stats.hitProbeTotal.fetch_add(probes, std::memory_order_relaxed);
     }
     else {
-        datapoints = m_oldSize - m_oldNumDeleted;
-        rehash_status = REHASH_STATUS::NOT_REHASHING; //updating rehash status
-    }
-    for (int i = 0, j = 0; i < datapoints; j++) {
-        if (!m_oldTable[j].m_sequence.empty() && m_oldTable[j].m_sequence != DELETEDKEY) {
-            unsigned int index = get_index_cur(m_oldTable[j], false);
-            m_currentTable[index] = m_oldTable[j];
-            m_oldTable[j] = DELETED;
-            i++; //only increasing i on transfer
-        }
-    }
-    //size adjustments
-    m_currentSize += datapoints;
-    m_oldNumDeleted += datapoints;
-    if (rehash_status == REHASH_STATUS::NOT_REHASHING) {
-        delete[] m_oldTable;
-        m_oldTable = nullptr;
-        m_oldCap = 0;
-        m_oldNumDeleted = 0;
-        m_oldSize = 0;
+        m_stats.misses.fetch_add(1, std::memory_order_relaxed);
+        m_stats.missProbes[bucket].fetch_add(1, std::memory_order_relaxed);
+        m_stats.missProbeTotal.fetch_add(probes, std::memory_order_relaxed);
+    }
+}
+#endif
+
+DnaDbStats DnaDb::stats() const {
+    //the migrator changes the table shape, writers are the caller's business
+    std::unique_lock<std::mutex> guard(m_lock, std::defer_lock);
+    if (m_background) {
+        guard.lock();
+    }
+    return collect_stats();
+}
+
+DnaDbStats DnaDb::collect_stats() const {
+    DnaDbStats stats;
+    memset(&stats, 0, sizeof(stats));
+    stats.capacity = m_currentCap;
+    stats.size = m_currentSize - m_currNumDeleted + m_oldSize - m_oldNumDeleted;
+    stats.deleted = m_currNumDeleted;
+    stats.tombstones = deletedRatio();
+    stats.rehashing = m_oldTable != nullptr;
+    stats.tableBytes = (m_currentCap + m_oldCap) *
+                       (sizeof(DNA) + sizeof(int8_t) + sizeof(Fingerprint) + sizeof(uint64_t));
+    stats.arenaBytes = arenaBytes();
+#ifdef DNADB_STATS
+    auto get = [](const std::atomic<uint64_t>& counter) {
+        return counter.load(std::memory_order_relaxed);
+    };
+    stats.counting = true;
+    stats.hits = get(m_stats.hits);
+    stats.misses = get(m_stats.misses);
+    stats.oldHits = get(m_stats.oldHits);
+    stats.currentHits = get(m_stats.currentHits);
+    for (int b = 0; b < PROBEBUCKETS; b++) {
+        stats.hitProbes[b] = get(m_stats.hitProbes[b]);
+        stats.missProbes[b] = get(m_stats.missProbes[b]);
+    }
+    stats.hitProbeTotal = get(m_stats.hitProbeTotal);
+    stats.missProbeTotal = get(m_stats.missProbeTotal);
+    stats.rehashes = get(m_stats.rehashes);
+    stats.shrinks = get(m_stats.shrinks);
+    stats.slotsMigrated = get(m_stats.slotsMigrated);
+    stats.entriesMigrated = get(m_stats.entriesMigrated);
+    stats.swapNanos = get(m_stats.swapNanos);
+    stats.migrateNanos = get(m_stats.migrateNanos);
+    stats.retireNanos = get(m_stats.retireNanos);
+#endif
+    return stats;
+}
+
+bool DnaDb::writeStats(const string& path) const {
+    ofstream out(path, ios::app);
+    out << stats().toJson() << endl;
+    return !out.fail();
+}
+
+void DnaDb::setStatsExport(const string& path, uint64_t everyWrites) {
+    m_statsPath = path;
+    m_statsEvery = everyWrites;
+    m_statsWrites = 0;
+}
+
+void DnaDb::wrote() {
+    //writers hold the lock already, so no stats() here
+    if (m_statsEvery != 0 && ++m_statsWrites >= m_statsEvery) {
+        m_statsWrites = 0;
+        ofstream out(m_statsPath, ios::app);
+        out << collect_stats().toJson() << endl;
     }
 }
+
+string DnaDbStats::toJson() const {
+    ostringstream out;
+    auto histogram = [&out](const uint64_t* buckets) {
+        out << "[";
+        for (int b = 0; b < PROBEBUCKETS; b++) {
+            out << (b ? "," : "") << buckets[b];
+        }
+        out << "]";
+    };
+    out << "{\"counting\":" << (counting ? "true" : "false")
+        << ",\"capacity\":" << capacity << ",\"size\":" << size << ",\"deleted\":" << deleted
+        << ",\"tombstones\":" << tombstones << ",\"rehashing\":" << (rehashing ? "true" : "false")
+        << ",\"tableBytes\":" << tableBytes << ",\"arenaBytes\":" << arenaBytes
+        << ",\"hits\":" << hits << ",\"misses\":" << misses
+        << ",\"oldHits\":" << oldHits << ",\"currentHits\":" << currentHits
+        << ",\"hitProbes\":";
+    histogram(hitProbes);
+    out << ",\"missProbes\":";
+    histogram(missProbes);
+    out << ",\"hitProbeTotal\":" << hitProbeTotal << ",\"missProbeTotal\":" << missProbeTotal
+        << ",\"rehashes\":" << rehashes << ",\"shrinks\":" << shrinks
+        << ",\"slotsMigrated\":" << slotsMigrated
+        << ",\"entriesMigrated\":" << entriesMigrated << ",\"swapNanos\":" << swapNanos
+        << ",\"migrateNanos\":" << migrateNanos << ",\"retireNanos\":" << retireNanos << "}";
+    return out.str();
+}
+
+PackedSeq::PackedSeq() : m_inline(0), m_length(0), m_packed(true), m_borrowed(false) {}
+
+// SWAR helpers on 8 characters read as one little-endian word
+const uint64_t BYTEONES = 0x0101010101010101ULL;
+
+// 0x80 in every byte of x that is zero, exact (no carries between bytes)
+static uint64_t zero_bytes(uint64_t x) {
+    const uint64_t low = 0x7F * BYTEONES;
+    return ~(((x & low) + low) | x | low);
+}
+
+// true if all 8 characters are in ALPHA
+static bool all_bases(uint64_t chars) {
+    uint64_t hits = zero_bytes(chars ^ ('A' * BYTEONES)) | zero_bytes(chars ^ ('C' * BYTEONES)) |
+                    zero_bytes(chars ^ ('G' * BYTEONES)) | zero_bytes(chars ^ ('T' * BYTEONES));
+    return hits == 0x80 * BYTEONES;
+}
+
+// Packs 8 bases into 16 bits. Bits 1 and 2 of the ASCII codes of A, C, G
+// and T xor to 0, 1, 2 and 3, the shifts then gather the 2-bit codes.
+static uint64_t pack_bases(uint64_t chars) {
+    uint64_t codes = ((chars >> 1) ^ (chars >> 2)) & (3 * BYTEONES);
+    codes = (codes | codes >> 6) & 0x000F000F000F000FULL;
+    codes = (codes | codes >> 12) & 0x000000FF000000FFULL;
+    return (codes | codes >> 24) & 0xFFFF;
+}
+
+// Builds word w of a sequence's packed (or raw) representation. Returns
+// false if packed is set and the word holds a character outside ALPHA.
+static bool load_word(string_view sequence, uint32_t w, bool packed, uint64_t& word) {
+    word = 0;
+    if (packed) {
+        uint32_t first = w * BASESPERWORD;
+        uint32_t last = min<size_t>(first + BASESPERWORD, sequence.length());
+        uint32_t i = first;
+        for (; i + 8 <= last; i += 8) {
+            uint64_t chars;
+            memcpy(&chars, sequence.data() + i, 8);
+            if (!all_bases(chars)) {
+                return false;
+            }
+            word |= pack_bases(chars) << (2 * (i - first));
+        }
+        for (; i < last; i++) {
+            uint64_t code;
+            switch (sequence[i]) {
+                case 'A': code = 0; break;
+                case 'C': code = 1; break;
+                case 'G': code = 2; break;
+                case 'T': code = 3; break;
+                default: return false;
+            }
+            word |= code << (2 * (i - first));
+        }
+        return true;
+    }
+    uint32_t first = w * BYTESPERWORD;
+    uint32_t last = min<size_t>(first + BYTESPERWORD, sequence.length());
+    for (uint32_t i = first; i < last; i++) {
+        word |= uint64_t((unsigned char)sequence[i]) << (8 * (i - first));
+    }
+    return true;
+}
+
+PackedSeq::PackedSeq(string_view sequence)
+        : m_inline(0), m_length(sequence.length()), m_packed(packable(sequence)), m_borrowed(false)
+{
+    uint32_t words = numWords();
+    uint64_t* dest = &m_inline;
+    if (words > 1) {
+        m_words = new uint64_t[words];
+        dest = m_words;
+    }
+    for (uint32_t w = 0; w < words; w++) {
+        load_word(sequence, w, m_packed, dest[w]);
+    }
+}
+
+PackedSeq::PackedSeq(const PackedSeq& rhs)
+        : m_inline(rhs.m_inline), m_length(rhs.m_length), m_packed(rhs.m_packed), m_borrowed(false)
+{
+    //a copy owns its words, even of a key borrowing from an arena
+    if (rhs.isSpilled()) {
+        uint32_t words = numWords();
+        m_words = new uint64_t[words];
+        for (uint32_t i = 0; i < words; i++) {
+            m_words[i] = rhs.m_words[i];
+        }
+    }
+}
+
+PackedSeq::PackedSeq(PackedSeq&& rhs) noexcept
+        : m_inline(rhs.m_inline), m_length(rhs.m_length), m_packed(rhs.m_packed),
+          m_borrowed(rhs.m_borrowed)
+{
+    // the spilled buffer (if any) now belongs to us
+    rhs.m_inline = 0;
+    rhs.m_length = 0;
+    rhs.m_packed = true;
+    rhs.m_borrowed = false;
+}
+
+PackedSeq::~PackedSeq() {
+    release();
+}
+
+PackedSeq& PackedSeq::operator=(const PackedSeq& rhs) {
+    if (this != &rhs) {
+        PackedSeq copy(rhs);
+        *this = std::move(copy);
+    }
+    return *this;
+}
+
+PackedSeq& PackedSeq::operator=(PackedSeq&& rhs) noexcept {
+    if (this != &rhs) {
+        release();
+        m_inline = rhs.m_inline;
+        m_length = rhs.m_length;
+        m_packed = rhs.m_packed;
+        m_borrowed = rhs.m_borrowed;
+        rhs.m_inline = 0;
+        rhs.m_length = 0;
+        rhs.m_packed = true;
+        rhs.m_borrowed = false;
+    }
+    return *this;
+}
+
+void PackedSeq::assign(const PackedSeq& rhs, SeqArena& arena) {
+    if (this == &rhs) {
+        return;
+    }
+    release();
+    m_inline = rhs.m_inline;
+    m_length = rhs.m_length;
+    m_packed = rhs.m_packed;
+    m_borrowed = rhs.isSpilled();
+    if (m_borrowed) {
+        m_words = arena.allocate(numWords());
+        memcpy(m_words, rhs.m_words, numWords() * sizeof(uint64_t));
+    }
+}
+
+void PackedSeq::assign(string_view sequence, SeqArena& arena) {
+    release();
+    m_length = sequence.length();
+    m_packed = packable(sequence);
+    uint32_t words = numWords();
+    m_borrowed = words > 1;
+    uint64_t* dest = &m_inline;
+    if (m_borrowed) {
+        m_words = arena.allocate(words);
+        dest = m_words;
+    }
+    for (uint32_t w = 0; w < words; w++) {
+        load_word(sequence, w, m_packed, dest[w]);
+    }
+}
+
+bool PackedSeq::packable(string_view sequence) {
+    size_t i = 0;
+    for (; i + 8 <= sequence.length(); i += 8) {
+        uint64_t chars;
+        memcpy(&chars, sequence.data() + i, 8);
+        if (!all_bases(chars)) {
+            return false;
+        }
+    }
+    for (; i < sequence.length(); i++) {
+        char base = sequence[i];
+        if (base != 'A' && base != 'C' && base != 'G' && base != 'T') {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool PackedSeq::equals(string_view sequence) const {
+    return equals(words(), m_length, m_packed, sequence);
+}
+
+bool PackedSeq::equals(const uint64_t* src, uint32_t length, bool packed, string_view sequence) {
+    //packs the string one word at a time, so nothing is allocated
+    if (sequence.length() != length) {
+        return false;
+    }
+    for (uint32_t w = 0, n = numWords(length, packed); w < n; w++) {
+        uint64_t word;
+        if (!load_word(sequence, w, packed, word) || word != src[w]) {
+            return false;
+        }
+    }
+    //a raw key always holds some character outside ALPHA, so a string
+    //matching it byte for byte would not have been packed either
+    return true;
+}
+
+string PackedSeq::toString() const {
+    return toString(words(), m_length, m_packed);
+}
+
+string PackedSeq::toString(const uint64_t* src, uint32_t length, bool packed) {
+    string sequence(length, ' ');
+    if (packed) {
+        for (uint32_t i = 0; i < length; i++) {
+            sequence[i] = ALPHA[(src[i / BASESPERWORD] >> (2 * (i % BASESPERWORD))) & 3];
+        }
+    }
+    else {
+        for (uint32_t i = 0; i < length; i++) {
+            sequence[i] = char((src[i / BYTESPERWORD] >> (8 * (i % BYTESPERWORD))) & 0xFF);
+        }
+    }
+    return sequence;
+}
+
+// hash of a key's words, with the kind fixed so the word loop has no switch
+template <HASH_KIND KIND>
+static uint64_t hash_words(const uint64_t* src, uint32_t length, bool packed, uint64_t seed) {
+    SeqHasher<KIND> hasher(seed, length, packed);
+    for (uint32_t w = 0, n = PackedSeq::numWords(length, packed); w < n; w++) {
+        hasher.add(src[w]);
+    }
+    return hasher.finish();
+}
+
+template <HASH_KIND KIND>
+static uint64_t hash_sequence(string_view sequence, bool packed, uint64_t seed) {
+    SeqHasher<KIND> hasher(seed, sequence.length(), packed);
+    for (uint32_t w = 0, n = PackedSeq::numWords(sequence.length(), packed); w < n; w++) {
+        uint64_t word;
+        load_word(sequence, w, packed, word);
+        hasher.add(word);
+    }
+    return hasher.finish();
+}
+
+uint64_t PackedSeq::hash(HASH_KIND kind, uint64_t seed) const {
+    switch (kind) {
+        case HASH_KIND::WYHASH:
+            return hash_words<HASH_KIND::WYHASH>(words(), m_length, m_packed, seed);
+        case HASH_KIND::ROLLING:
+            return hash_words<HASH_KIND::ROLLING>(words(), m_length, m_packed, seed);
+        default:
+            return hash_words<HASH_KIND::PACKED>(words(), m_length, m_packed, seed);
+    }
+}
+
+uint64_t PackedSeq::hash(string_view sequence, HASH_KIND kind, uint64_t seed) {
+    //same value as PackedSeq(sequence).hash() without building the key
+    bool packed = packable(sequence);
+    switch (kind) {
+        case HASH_KIND::WYHASH:
+            return hash_sequence<HASH_KIND::WYHASH>(sequence, packed, seed);
+        case HASH_KIND::ROLLING:
+            return hash_sequence<HASH_KIND::ROLLING>(sequence, packed, seed);
+        default:
+            return hash_sequence<HASH_KIND::PACKED>(sequence, packed, seed);
+    }
+}
+
+uint32_t PackedSeq::numWords() const {
+    return numWords(m_length, m_packed);
+}
+
+uint32_t PackedSeq::numWords(uint32_t length, bool packed) {
+    uint32_t perWord = packed ? BASESPERWORD : BYTESPERWORD;
+    return (length + perWord - 1) / perWord;
+}
+
+void PackedSeq::release() {
+    if (isSpilled() && !m_borrowed) {
+        delete[] m_words;
+    }
+    m_inline = 0;
+    m_borrowed = false;
+}
+
+SeqArena::SeqArena()
+        :m_free(0), m_next(ARENAFIRSTCHUNK), m_reserved(0) {}
+
+SeqArena::~SeqArena() {
+    clear();
+}
+
+uint64_t* SeqArena::allocate(uint32_t words) {
+    if (words > m_free) {
+        //a key longer than the next chunk gets a chunk of its own size
+        uint64_t size = max<uint64_t>(m_next, words);
+        m_chunks.push_back(new uint64_t[size]);
+        m_reserved += size;
+        m_free = size;
+        m_next = min(m_next * 2, ARENAMAXCHUNK);
+    }
+    //carve from the end of the last chunk, so m_free alone tracks it
+    m_free -= words;
+    return m_chunks.back() + m_free;
+}
+
+void SeqArena::absorb(SeqArena& other) {
+    if (m_chunks.empty()) {
+        //keep other's partly used last chunk as ours
+        m_chunks.swap(other.m_chunks);
+        m_free = other.m_free;
+        m_next = other.m_next;
+    }
+    else {
+        //our last chunk stays last, other's spare words are given up
+        m_chunks.insert(m_chunks.end() - 1, other.m_chunks.begin(), other.m_chunks.end());
+        other.m_chunks.clear();
+    }
+    m_reserved += other.m_reserved;
+    other.m_free = 0;
+    other.m_next = ARENAFIRSTCHUNK;
+    other.m_reserved = 0;
+}
+
+void SeqArena::clear() {
+    for (uint64_t* chunk : m_chunks) {
+        delete[] chunk;
+    }
+    m_chunks.clear();
+    m_free = 0;
+    m_next = ARENAFIRSTCHUNK;
+    m_reserved = 0;
+}
+
+bool operator==(const PackedSeq& lhs, const PackedSeq& rhs) {
+    if (lhs.m_length != rhs.m_length || lhs.m_packed != rhs.m_packed) {
+        return false;
+    }
+    const uint64_t* a = lhs.words();
+    const uint64_t* b = rhs.words();
+    for (uint32_t i = 0, n = lhs.numWords(); i < n; i++) {
+        if (a[i] != b[i]) {
+            return false;
+        }
+    }
+    return true;
+}
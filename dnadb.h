@@ -2,87 +2,511 @@
 #define DNADB_H
 #include <iostream>
 #include <string>
+#include <string_view>
+#include <cstdint>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <type_traits>
 #include "math.h"
+#include "primetable.h"
+#include "dnahash.h"
+#include "slotalloc.h"
 using namespace std;
 class Grader;   // forward declaration, will be used for grdaing
 class Tester;   // forward declaration, will be used for testing
+class PackedSeq;// forward declaration
+class SeqArena; // forward declaration
 class DNA;      // forward declaration
 class DnaDb;    // forward declaration
 const int MINLOCID = 1000;
 const int MAXLOCID = 9999;
 const int MINPRIME = 101;   // Min size for hash table
-const int MAXPRIME = 99991; // Max size for hash table
+const uint64_t MAXPRIME = PRIMETABLE[NUMPRIMES - 1].prime; // Max size for hash table
 #define EMPTY DNA("")
-#define DELETED DNA("DELETED")
-#define DELETEDKEY "DELETED"
-typedef unsigned int (*hash_fn)(string); // declaration of hash function
+typedef unsigned int (*hash_fn)(string_view); // declaration of hash function
+// How the table is sized and how a hash is reduced to a slot index
+enum class TABLE_MODE {
+    PRIME,          // PRIMETABLE sizes, fastmod reduction, triangular probing
+    POWER_OF_TWO,   // power-of-two sizes, mixed hash and mask, triangular probing
+    SWISS,          // power-of-two sizes, SIMD scan of 1-byte control tags
+    ROBIN_HOOD      // power-of-two sizes, linear probing kept in home order,
+                    // backward-shift deletion instead of tombstones
+};
+const float MAXLOAD = .5f;          // load factor that triggers a rehash
+const float SWISSMAXLOAD = .875f;   // the same for TABLE_MODE::SWISS
+const float ROBINMAXLOAD = .875f;   // the same for TABLE_MODE::ROBIN_HOOD
+const float MINLOAD = .125f;        // live load below which remove() shrinks the table
+const uint64_t REHASHBUDGET = 16;   // default old slots migrated per insert/remove
+const uint64_t BACKGROUNDCHUNK = 1024;  // old slots a migrator thread moves per lock hold
+const int BATCHWINDOW = 16;         // lookups findMany keeps in flight
+// Every slot has a 1-byte control tag holding its state, so probes never
+// build or compare sentinel DNA objects
+const int8_t CTRL_EMPTY = -128;     // control tag of a never used slot
+const int8_t CTRL_DELETED = -2;     // control tag of a removed slot
+const int8_t CTRL_FULL = 0;         // control tag of a full slot
+const int8_t CTRL_BUSY = -1;        // control tag of a slot a bulk load is filling
+// in SWISS mode a full slot's tag is the low 7 bits of its hash (0..127),
+// so any tag >= 0 means full
 const int MAX = 4;
 const char ALPHA[MAX] = {'A', 'C', 'G', 'T'};
+const int BASESPERWORD = 32;    // 2-bit bases held by one 64-bit word
+const int BYTESPERWORD = 8;     // raw characters held by one 64-bit word
+const uint64_t ARENAFIRSTCHUNK = 256;       // words in an arena's first chunk
+const uint64_t ARENAMAXCHUNK = 1 << 16;     // chunks double up to this many words
+const int PROBEBUCKETS = 8;     // buckets of the probe length histograms
+// Every slot also keeps a fingerprint, the top DNADB_FINGERPRINT_BITS bits
+// of its mixed hash, in a dense array of its own. A probe compares those
+// first and reads the slot's DNA only on a match, so the hot bytes per
+// candidate are its control tag and fingerprint: 8 bits fit 64 candidates
+// in a cache line and 64 bits fit 8, a wider fingerprint lets fewer
+// other keys through to the key compare (1 in 2^bits).
+#ifndef DNADB_FINGERPRINT_BITS
+#define DNADB_FINGERPRINT_BITS 16
+#endif
+static_assert(DNADB_FINGERPRINT_BITS == 8 || DNADB_FINGERPRINT_BITS == 16 ||
+              DNADB_FINGERPRINT_BITS == 32 || DNADB_FINGERPRINT_BITS == 64,
+              "DNADB_FINGERPRINT_BITS must be 8, 16, 32 or 64");
+typedef std::conditional_t<DNADB_FINGERPRINT_BITS == 8, uint8_t,
+        std::conditional_t<DNADB_FINGERPRINT_BITS == 16, uint16_t,
+        std::conditional_t<DNADB_FINGERPRINT_BITS == 32, uint32_t, uint64_t>>> Fingerprint;
+// Building with -DDNADB_STATS makes DnaDb count its lookups, probes and
+// rehash work, see DnaDb::stats(). Otherwise DNADB_STAT() compiles away.
+#ifdef DNADB_STATS
+#define DNADB_STAT(statement) statement
+#else
+#define DNADB_STAT(statement)
+#endif
+
+// Key storage for DNA. Sequences over ALPHA are packed 2 bits per base,
+// anything else (e.g. "ACGTN") is kept as raw bytes. Either way the key
+// is an array of 64-bit words with the unused high bits zeroed, so hashing
+// and equality work on whole words. A single word is stored inline, longer
+// keys spill to the heap, or to a SeqArena when the key lives in a DnaDb
+// slot (the key then only borrows its words, and copies of it own theirs).
+class PackedSeq{
+public:
+    friend class Tester;
+    friend class DnaDbView;
+    PackedSeq();
+    PackedSeq(string_view sequence);
+    PackedSeq(const PackedSeq& rhs);
+    PackedSeq(PackedSeq&& rhs) noexcept;
+    ~PackedSeq();
+    PackedSeq& operator=(const PackedSeq& rhs);
+    PackedSeq& operator=(PackedSeq&& rhs) noexcept;
+    // Returns true if every character of sequence is in ALPHA
+    static bool packable(string_view sequence);
+    string toString() const;
+    uint32_t length() const { return m_length; }
+    bool empty() const { return m_length == 0; }
+    bool isPacked() const { return m_packed; }
+    // Compares against an unpacked string without building a PackedSeq
+    bool equals(string_view sequence) const;
+    // The same on key words stored elsewhere (e.g. a snapshot file)
+    static bool equals(const uint64_t* words, uint32_t length, bool packed, string_view sequence);
+    static string toString(const uint64_t* words, uint32_t length, bool packed);
+    // words needed to hold length bases (or raw characters)
+    static uint32_t numWords(uint32_t length, bool packed);
+    // Word-at-a-time hash of the packed representation, see dnahash.h
+    uint64_t hash(HASH_KIND kind = HASH_KIND::PACKED, uint64_t seed = 0) const;
+    // hash() of PackedSeq(sequence), computed without allocating
+    static uint64_t hash(string_view sequence, HASH_KIND kind = HASH_KIND::PACKED,
+                         uint64_t seed = 0);
+    friend bool operator==(const PackedSeq& lhs, const PackedSeq& rhs);
+    // Makes this key a copy of rhs (or of sequence) whose spilled words
+    // are carved out of arena instead of the heap
+    void assign(const PackedSeq& rhs, SeqArena& arena);
+    void assign(string_view sequence, SeqArena& arena);
+
+private:
+    union {
+        uint64_t    m_inline;   // key words when numWords() <= 1
+        uint64_t*   m_words;    // spilled key words otherwise
+    };
+    uint32_t        m_length;   // number of bases (or raw characters)
+    bool            m_packed;   // 2-bit bases if true, raw bytes if false
+    bool            m_borrowed; // spilled words belong to a SeqArena
+
+    uint32_t numWords() const;
+    bool isSpilled() const { return numWords() > 1; }
+    const uint64_t* words() const { return isSpilled() ? m_words : &m_inline; }
+    void release();
+};
+
+// Bump allocator for the spilled key words of a DnaDb table. Words are
+// carved out of chunks that double in size up to ARENAMAXCHUNK, so a table
+// of long keys costs a handful of allocations instead of one per entry.
+// Nothing is freed on its own: removed keys keep their words until the
+// table is rehashed into a new arena and the old one is cleared.
+class SeqArena{
+public:
+    SeqArena();
+    ~SeqArena();
+    SeqArena(const SeqArena&) = delete;
+    SeqArena& operator=(const SeqArena&) = delete;
+    uint64_t* allocate(uint32_t words);
+    // Takes over other's chunks, leaving it empty
+    void absorb(SeqArena& other);
+    // Frees every chunk, keys still borrowing from them dangle
+    void clear();
+    // bytes reserved by the chunks
+    uint64_t bytes() const { return m_reserved * sizeof(uint64_t); }
+private:
+    vector<uint64_t*>   m_chunks;
+    uint64_t            m_free;     // words left in the last chunk
+    uint64_t            m_next;     // size of the next chunk
+    uint64_t            m_reserved; // words in all chunks
+};
 
 class DNA{
 public:
     friend class Grader;
     friend class Tester;
     friend class DnaDb;
-    DNA(string sequence="", int location=0); // Constructor
+    friend class ConcurrentDnaDb;
+    friend class LockFreeDnaDb;
+    friend class MultiDnaDb;
+    friend class DnaDbView;
+    DNA(string_view sequence="", int location=0); // Constructor
+    DNA(const DNA& rhs) = default;
+    DNA(DNA&& rhs) noexcept = default;
     string getSequence() const;              // Returns the key
     int getLocId() const;
     // Overloaded assignment operator
     const DNA& operator=(const DNA& rhs);
+    // Move assignment, takes over a spilled key instead of copying it
+    const DNA& operator=(DNA&& rhs) noexcept;
     // Overloaded insertion operator
     friend ostream& operator<<(ostream& sout, const DNA &dna );
     // Overloaded equality operator
     friend bool operator==(const DNA& lhs, const DNA& rhs);
 private:
-    string m_sequence;  // this is the object key
+    PackedSeq m_sequence;  // this is the object key
     int m_location;     // some info
 };
 
+// A DnaDb's shape, and in DNADB_STATS builds what it has done so far.
+// Probe lengths count the slots (groups in SWISS mode) a lookup looked at
+// over both tables. Bucket b holds lengths up to 2^b, above those of
+// bucket b - 1; the last bucket takes everything longer.
+struct DnaDbStats {
+    bool        counting;       // built with DNADB_STATS, else the counters are 0
+    uint64_t    capacity;       // slots of the current table
+    uint64_t    size;           // live entries in both tables
+    uint64_t    deleted;        // deleted slots of the current table
+    float       tombstones;     // deletedRatio()
+    bool        rehashing;      // an old table is still being migrated
+    uint64_t    tableBytes;     // slots, tags, fingerprints and hashes of both tables
+    uint64_t    arenaBytes;     // spilled key words of both tables
+    uint64_t    hits;
+    uint64_t    misses;
+    uint64_t    oldHits;        // hits in the old table, during a rehash
+    uint64_t    currentHits;    // hits in the current table
+    uint64_t    hitProbes[PROBEBUCKETS];
+    uint64_t    missProbes[PROBEBUCKETS];
+    uint64_t    hitProbeTotal;
+    uint64_t    missProbeTotal;
+    uint64_t    rehashes;
+    uint64_t    shrinks;        // rehashes into a smaller table
+    uint64_t    slotsMigrated;  // old slots visited by the migration
+    uint64_t    entriesMigrated;
+    uint64_t    swapNanos;      // allocating new tables
+    uint64_t    migrateNanos;   // moving entries over
+    uint64_t    retireNanos;    // waiting out readers and freeing old tables
+    // the whole snapshot as a one line JSON object
+    string toJson() const;
+};
+
 class DnaDb{
 public:
     friend class Grader;
     friend class Tester;
-    DnaDb(int size, hash_fn hash);
+    friend class DnaDbView;
+    // Passing a null hash selects the packed key mode, which hashes the
+    // 2-bit packed words directly instead of the sequence string. hash_fn
+    // only yields 32 bits, so tables past 2^32 slots should use packed keys.
+    DnaDb(uint64_t size, hash_fn hash, TABLE_MODE mode = TABLE_MODE::PRIME);
+    // Packed keys hashed with one of the built-in hashes of dnahash.h
+    DnaDb(uint64_t size, HASH_KIND kind, uint64_t seed = 0,
+          TABLE_MODE mode = TABLE_MODE::PRIME);
+    // Builds a table holding entries[0..count), see bulkLoad()
+    DnaDb(const DNA* entries, size_t count, hash_fn hash,
+          TABLE_MODE mode = TABLE_MODE::PRIME, unsigned threads = 1);
     ~DnaDb();
     // Returns Load factor of the new table
     float lambda() const;
     // Returns the ratio of deleted slots in the new table
     float deletedRatio() const;
-    // insert only happens in the new table
-    bool insert(DNA dna);
+    // Returns the number of slots in the new table
+    uint64_t capacity() const;
+    // Returns the bytes held for spilled keys (both arenas while a rehash
+    // is in progress)
+    uint64_t arenaBytes() const;
+    // Sets how many old table slots each insert/remove migrates while a
+    // rehash is in progress. Larger budgets finish sooner, smaller ones
+    // keep each operation cheaper. The table raises it if needed to finish
+    // before the new table fills up.
+    void setRehashBudget(uint64_t slots);
+    // Moves rehash migration to a dedicated thread. insert/remove then
+    // never migrate (they only wait for the chunk in flight) and find/getDNA
+    // stay lock-free, reading both tables under an epoch that keeps the old
+    // table alive. This only makes readers safe alongside the migrator:
+    // they may run concurrently with each other and with it, never with
+    // insert, remove or any other non-const call, which still need the
+    // caller's own locking (see ConcurrentDnaDb). A find() pointer into the
+    // old table dangles once the migrator frees it, so readers racing the
+    // migrator should copy with getDNA/getDNABatch. Ignored in ROBIN_HOOD
+    // mode, where migrating an entry shifts others under the readers.
+    void setBackgroundRehash(bool enabled);
+    // Blocks until any rehash in progress has finished
+    void finishRehash();
+    // Sets the live load below which remove() rehashes into a smaller
+    // table, MINLOAD by default. 0 never shrinks.
+    void setMinLoad(float load);
+    // Makes room for entries live entries without a rehash. The table does
+    // not shrink below that room until shrinkToFit().
+    void reserve(uint64_t entries);
+    // Rehashes into the table a rehash would give the live entries now,
+    // dropping deleted slots, the words of removed keys and any reserve().
+    // Returns when the old table is freed, false if there was nothing to
+    // give back. Slot arrays of GIVEBACKBYTES or more are mapped on their
+    // own, so freeing them returns their pages to the OS.
+    bool shrinkToFit();
+    // Moves the table onto slot arrays from allocator (huge pages, NUMA
+    // placement, see slotalloc.h), which then also backs every table a
+    // rehash makes. nullptr is SlotAllocator::standard(). The allocator
+    // must outlive the DnaDb.
+    void setSlotAllocator(SlotAllocator* allocator);
+    // insert only happens in the new table. Spilled keys are always copied
+    // into the table's arena, so there is nothing to gain from moving dna.
+    bool insert(const DNA& dna);
+    // insert that builds the key straight into its slot
+    bool emplace(string_view sequence, int location);
+    // Inserts entries[0..count) at once: the table is sized for all of them
+    // up front (one full migration at most), then filled without any
+    // per-insert load checks. With threads > 1 the keys are hashed in
+    // parallel and each thread fills the keys whose probe sequence starts
+    // in its share of the slots, claiming slots with a CAS on their tag.
+    // Returns the number of entries inserted (bad locations and duplicates
+    // are skipped, as by insert).
+    uint64_t bulkLoad(const DNA* entries, size_t count, unsigned threads = 1);
     // remove can happen from either table
-    bool remove(DNA dna);
-    // find can happen in either table
-    DNA getDNA(string sequence, int location);
+    bool remove(const DNA& dna);
+    // find can happen in either table. Returns nullptr when absent. The
+    // pointer is only valid until the next non-const call (insert, remove,
+    // bulkLoad, reserve, shrinkToFit, ...) and, with a background rehash
+    // running, until the migrator's next chunk, which may free the old
+    // table it points into. Use getDNA to keep the entry past that.
+    const DNA* find(string_view sequence, int location) const;
+    // copying version of find, returns EMPTY when absent. The copy is made
+    // under the read epoch, so it is the one to use alongside a background
+    // migrator.
+    DNA getDNA(string_view sequence, int location) const;
+    // Batched find: results[i] = find(sequences[i], locations[i]). Keys are
+    // hashed and their home slots prefetched BATCHWINDOW lookups ahead of
+    // being probed, so the cache misses of neighbouring lookups overlap.
+    // Returns the number of keys found. The pointers last as find()'s do.
+    size_t findMany(const string_view* sequences, const int* locations, size_t count,
+                    const DNA** results) const;
+    // Batched getDNA, absent keys come back as EMPTY
+    void getDNABatch(const string_view* sequences, const int* locations, size_t count,
+                     DNA* results) const;
+    // k-mer mode: every window sequence[i, i + k) of bases in ALPHA is a
+    // key at location (windows with other characters are skipped). No
+    // substring is built: windows are hashed in place, and in O(1) each by
+    // sliding the rolling hash when the table uses HASH_KIND::ROLLING.
+    // With canonical set a window and its reverse complement are the same
+    // key, stored as whichever of the two hashes lower; insert and find
+    // must agree on it. Returns the number of k-mers inserted.
+    uint64_t insertKmers(string_view sequence, uint32_t k, int location, bool canonical = false);
+    // Batched find of every window: results[i] = find(window i), nullptr
+    // for skipped windows. results needs sequence.length() - k + 1 entries.
+    // Returns the number of windows found. The pointers last as find()'s do.
+    size_t findKmers(string_view sequence, uint32_t k, int location, const DNA** results,
+                     bool canonical = false) const;
     void dump() const;
+    // Snapshot of the table and its counters, see DnaDbStats. Safe to call
+    // while a background migrator runs, not during insert/remove.
+    DnaDbStats stats() const;
+    // Appends stats().toJson() as one line to path, false if it cannot be
+    // written
+    bool writeStats(const string& path) const;
+    // Appends the stats to path after every everyWrites successful inserts
+    // and removes (bulkLoad() counts as one), 0 turns the export off
+    void setStatsExport(const string& path, uint64_t everyWrites);
+    // Writes every entry to a binary snapshot that DnaDbView can map back
+    // in, see snapshot.h. Returns false if the file cannot be written.
+    bool saveSnapshot(const string& path) const;
 
 private:
     hash_fn         m_hash;         // hash function
+    HASH_KIND       m_hashKind;     // built-in hash used when m_hash is null
+    uint64_t        m_seed;         // its seed
+    TABLE_MODE      m_mode;         // sizing and index reduction
 
     DNA*            m_currentTable; // hash table
-    unsigned int    m_currentCap;   // hash table size
-    unsigned int    m_currentSize;  // current number of entries
+    uint64_t        m_currentCap;   // hash table size
+    uint64_t        m_currentSize;  // current number of entries
     // m_currentSize includes deleted entries
-    unsigned int    m_currNumDeleted;// number of deleted entries
+    uint64_t        m_currNumDeleted;// number of deleted entries
+    uint128_t       m_currentMagic; // fastmod magic of m_currentCap
+    int8_t*         m_currentCtrl;  // control tags
+    Fingerprint*    m_currentPrints;// fingerprint of every full slot, probed
+    uint64_t*       m_currentHashes;// full hash of every full slot, for rehashing
+    SlotAllocator*  m_currentAllocator; // source of the three arrays above
 
     DNA*            m_oldTable;     // hash table
-    unsigned int    m_oldCap;       // hash table size
-    unsigned int    m_oldSize;      // current number of entries
+    uint64_t        m_oldCap;       // hash table size
+    uint64_t        m_oldSize;      // current number of entries
     // m_oldSize includes deleted entries
-    unsigned int    m_oldNumDeleted;// number of deleted entries
+    uint64_t        m_oldNumDeleted;// number of deleted entries
+    uint128_t       m_oldMagic;     // fastmod magic of m_oldCap
+    int8_t*         m_oldCtrl;      // control tags
+    Fingerprint*    m_oldPrints;    // fingerprint of every full slot
+    uint64_t*       m_oldHashes;    // full hash of every full slot
+    SlotAllocator*  m_oldAllocator;
+    SlotAllocator*  m_allocator;    // source of the next table, see setSlotAllocator()
+
+    // spilled key words of each table, a rehash compacts the live keys
+    // into the new table's arena and frees the old one with its table
+    SeqArena        m_currentArena;
+    SeqArena        m_oldArena;
 
     //private helper functions
-    bool isPrime(int number);
-    int findNextPrime(int current);
+    uint64_t findNextPrime(uint64_t current);
 
     /******************************************
     * Private function declarations go here! *
     ******************************************/
-    enum class REHASH_STATUS { NOT_REHASHING, QUARTER, HALF, THREE_QUARTER };
-    REHASH_STATUS rehash_status;
-    unsigned int get_index_cur(DNA dna, bool deleted_empty) const;
-    unsigned int get_index_old(DNA dna, bool deleted_empty) const;
+    // a rehash is in progress while m_oldTable is set
+    uint64_t m_migrateCursor;   // next old table slot to migrate
+    uint64_t m_migrateStep;     // old slots migrated per insert/remove
+    uint64_t m_rehashBudget;    // requested m_migrateStep
+    bool     m_oldPublished;    // readers may probe the old table
+    float    m_minLoad;         // see setMinLoad()
+    uint64_t m_reserveSlots;    // slots reserve() asked for, 0 when none
+
+    // background rehash, see setBackgroundRehash()
+    bool                    m_background;   // a migrator thread is running
+    bool                    m_stop;         // asks the migrator to exit
+    std::thread             m_migrator;
+    mutable std::mutex      m_lock;         // serializes writers and the migrator
+    std::condition_variable m_wake;         // a rehash started or m_stop was set
+    std::condition_variable m_done;         // a rehash finished
+    mutable std::atomic<uint64_t> m_epoch;  // bumped each time a table is retired
+    mutable std::atomic<int64_t> m_readers[2];  // readers per epoch parity
+
+    // periodic stats export, see setStatsExport()
+    string      m_statsPath;
+    uint64_t    m_statsEvery;   // 0 when off
+    uint64_t    m_statsWrites;  // writes since the last export
+#ifdef DNADB_STATS
+    // the counters of DnaDbStats, relaxed atomics since lookups may run on
+    // several threads at once
+    struct StatCounters {
+        std::atomic<uint64_t>   hits{0}, misses{0}, oldHits{0}, currentHits{0};
+        std::atomic<uint64_t>   hitProbes[PROBEBUCKETS] = {}, missProbes[PROBEBUCKETS] = {};
+        std::atomic<uint64_t>   hitProbeTotal{0}, missProbeTotal{0};
+        std::atomic<uint64_t>   rehashes{0}, shrinks{0}, slotsMigrated{0}, entriesMigrated{0};
+        std::atomic<uint64_t>   swapNanos{0}, migrateNanos{0}, retireNanos{0};
+    };
+    mutable StatCounters m_stats;
+    void count_lookup(bool hit, bool old) const;
+#endif
+    // A key being probed for: either a stored DNA's packed sequence or a
+    // borrowed string, with its location and hash worked out once
+    struct KeyRef {
+        const PackedSeq*    packed;     // nullptr when probing with view
+        string_view         view;
+        int                 location;
+        uint64_t            hash;
+    };
+    KeyRef key_of(const DNA& dna) const;
+    KeyRef key_of(string_view sequence, int location) const;
+    static Fingerprint fingerprint(uint64_t hash);
+    // compares the key itself, after the slot's fingerprint matched
+    bool matches(const DNA& slot, const KeyRef& key) const;
+    bool claim_slot(const KeyRef& key, uint64_t& index);
+    // copies an entry into a claimed slot of the current table
+    void store(uint64_t index, const PackedSeq& sequence, int location, SeqArena& arena);
+    void commit_slot(uint64_t index, const KeyRef& key);
+    uint64_t find_capacity(uint64_t current, uint128_t& magic) const;
+    float max_load() const;
+    static float mode_max_load(TABLE_MODE mode);
+    bool over_load(uint64_t slots) const;
+    int8_t* new_ctrl(uint64_t cap) const;
+    int8_t ctrl_tag(uint64_t hash) const;
+    uint64_t get_index_swiss(const DNA* table, const int8_t* ctrl, const Fingerprint* prints,
+                             uint64_t cap, const KeyRef& key, bool deleted_empty) const;
+    // PRIME and POWER_OF_TWO probing, the same contract as get_index_swiss.
+    // Probe and Growth are hashtable.h policies, so the home slot and the
+    // step inline into the loop; get_index_cur/old pick them by m_mode.
+    template <class Probe, class Growth>
+    uint64_t get_index_probe(const DNA* table, const int8_t* ctrl, const Fingerprint* prints,
+                             uint64_t cap, uint128_t magic, const KeyRef& key,
+                             bool deleted_empty) const;
+    // ROBIN_HOOD probing: the slot holding key, else cap (whose control
+    // tag is always CTRL_EMPTY). at is where key would be inserted.
+    uint64_t get_index_robin(const DNA* table, const int8_t* ctrl, const Fingerprint* prints,
+                             const uint64_t* hashes, uint64_t cap, const KeyRef& key,
+                             uint64_t& at) const;
+    // slots from the home of the hash cached at index, ROBIN_HOOD only
+    uint64_t home_distance(const uint64_t* hashes, uint64_t index, uint64_t cap) const;
+    // frees the slot key goes to in a ROBIN_HOOD current table by shifting
+    // the entries from there on one slot up, or returns m_currentCap if
+    // key is there already
+    uint64_t robin_claim(const KeyRef& key);
+    // empties a ROBIN_HOOD current table slot by shifting the entries
+    // after it back
+    void robin_remove(uint64_t index);
+    uint64_t get_index_cur(const KeyRef& key, bool deleted_empty) const;
+    uint64_t get_index_old(const KeyRef& key, bool deleted_empty) const;
     void rehash();
+    // slots rehash() asks for with live entries, at least the reserve()
+    uint64_t rehash_size(uint64_t live) const;
+    // true if live entries are under the min load and a rehash would
+    // actually shrink the table
+    bool under_load() const;
+    void swap_tables(uint64_t size);
+    uint64_t bulk_claim(const KeyRef& key);
+    template <class Probe, class Growth>
+    uint64_t bulk_claim_probe(const KeyRef& key);
+    void bulk_fill(const DNA* entries, const KeyRef* keys, size_t count,
+                   uint64_t first, uint64_t last, SeqArena& arena, uint64_t& inserted);
+    void migrate(uint64_t slots);
+    void retire_old();
+    void migrate_worker();
+    std::unique_lock<std::mutex> lock_writes();
+    int enter_read() const;
+    void exit_read(int parity) const;
+    void wait_for_readers();
+    const DNA* find_slot(const KeyRef& key) const;
+    DnaDbStats collect_stats() const;
+    // counts a write towards the periodic stats export
+    void wrote();
+    void prefetch(const KeyRef& key) const;
+    uint64_t probe_start(uint64_t hash, uint64_t cap, uint128_t magic) const;
+    KeyRef batch_key(string_view sequence, int location) const;
+    // inserts key.view, as emplace
+    bool emplace_key(const KeyRef& key);
+    // insert, remove, find and getDNA for a key whose hash the caller has
+    // worked out already (ConcurrentDnaDb picks the shard with it).
+    // find_key and get_key expect a valid location.
+    bool insert_key(const DNA& dna, const KeyRef& key);
+    bool remove_key(const KeyRef& key);
+    const DNA* find_key(const KeyRef& key) const;
+    DNA get_key(const KeyRef& key) const;
+    // visit(start, hash, flip) for every k-mer, see insertKmers()
+    template <class Visit>
+    void walk_kmers(string_view sequence, uint32_t k, bool canonical, Visit visit) const;
+    // produce(emit) calls emit(id, key) for each key to find, visit(id, dna)
+    // gets the results in the same order
+    template <class Produce, class Visit>
+    size_t find_batch(Produce produce, Visit visit) const;
     friend class Tester;
+    friend class ConcurrentDnaDb;
 };
 #endif
\ No newline at end of file
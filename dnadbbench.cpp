@@ -0,0 +1,299 @@
+#include "dnadb.h"
+#include "dnarandom.h"
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+// Performance suite for regression tracking. For every table mode, table
+// size (powers of ten from 10^3 up to max size), key length and load factor
+// it fills a packed key DnaDb sized to end up at that load, then measures:
+//
+//   insert       emplace of every key into the empty table
+//   find         lookups drawn at random, hit ratio of them present
+//                (find/hit:1 is all hits, find/hit:0 all misses)
+//   remove       removal of every key
+//
+// Each result covers at least MINOPS operations (small tables are rebuilt
+// as often as needed) and reports throughput from the whole run plus
+// latency percentiles from every SAMPLEEVERY-th operation timed on its
+// own, less the clock's own overhead. Keys come from sequencer(), so runs
+// are reproducible; hits use locations in the lower half of the location
+// range and misses other sequences in the upper half. Loads at or above a
+// mode's max load (which would rehash mid fill) are skipped.
+//
+// Output goes to stdout, or to the file given, as JSON laid out like
+// Google Benchmark's (a "context" and a "benchmarks" array, real_time in
+// ns per operation) or as CSV with the same fields.
+//
+// usage: dnadbbench [json|csv] [max size] [lengths] [loads] [hit ratios]
+//                   [modes] [output file]
+// lists are comma separated, defaults: json 1000000 5,31,150 0.25,0.45,0.85
+// 1,0.5,0 prime,pow2,swiss,robin. The full sweep is max size 100000000.
+using Clock = std::chrono::steady_clock;
+
+const uint64_t MINOPS = 200000;     // operations each result is measured over
+const uint64_t SAMPLEEVERY = 16;    // every 16th operation is timed alone
+const int LOCSPAN = (MAXLOCID - MINLOCID + 1) / 2;  // locations of hits, and of misses
+
+struct Mode {
+    const char* name;
+    TABLE_MODE  mode;
+    float       maxLoad;
+};
+
+const Mode MODES[] = {
+    {"prime", TABLE_MODE::PRIME, MAXLOAD},
+    {"pow2", TABLE_MODE::POWER_OF_TWO, MAXLOAD},
+    {"swiss", TABLE_MODE::SWISS, SWISSMAXLOAD},
+    {"robin", TABLE_MODE::ROBIN_HOOD, ROBINMAXLOAD}
+};
+
+// one line of output
+struct Result {
+    string      op;
+    const Mode* mode;
+    uint64_t    size;
+    int         length;
+    float       load;           // requested
+    float       actualLoad;     // entries / capacity once filled
+    float       hitRatio;       // find only, -1 otherwise
+    uint64_t    ops;
+    double      nsPerOp;
+    double      percentiles[5]; // p50, p90, p99, p99.9, max
+};
+
+const double QUANTILES[5] = {.5, .9, .99, .999, 1};
+const char* QUANTILENAMES[5] = {"p50_ns", "p90_ns", "p99_ns", "p999_ns", "max_ns"};
+
+double nanos(Clock::duration elapsed) {
+    return std::chrono::duration<double, std::nano>(elapsed).count();
+}
+
+// median cost of reading the clock, taken off every timed operation
+double clockOverhead() {
+    vector<double> reads(10001);
+    for (double& read : reads) {
+        Clock::time_point start = Clock::now();
+        read = nanos(Clock::now() - start);
+    }
+    std::nth_element(reads.begin(), reads.begin() + reads.size() / 2, reads.end());
+    return reads[reads.size() / 2];
+}
+
+// Times op(0..count) as a whole, and each SAMPLEEVERY-th call on its own
+class Timer {
+public:
+    Timer(double overhead) : m_overhead(overhead), m_total(0), m_ops(0) {}
+    template <class Op>
+    void run(uint64_t count, Op op) {
+        Clock::time_point start = Clock::now();
+        for (uint64_t i = 0; i < count; i++) {
+            if (i % SAMPLEEVERY == 0) {
+                Clock::time_point before = Clock::now();
+                op(i);
+                m_samples.push_back(max(0.0, nanos(Clock::now() - before) - m_overhead));
+            }
+            else {
+                op(i);
+            }
+        }
+        m_total += nanos(Clock::now() - start);
+        m_ops += count;
+    }
+    void report(Result& result) {
+        result.ops = m_ops;
+        result.nsPerOp = m_ops == 0 ? 0 : m_total / double(m_ops);
+        std::sort(m_samples.begin(), m_samples.end());
+        for (int q = 0; q < 5; q++) {
+            size_t rank = m_samples.empty() ? 0 : size_t(QUANTILES[q] * (m_samples.size() - 1));
+            result.percentiles[q] = m_samples.empty() ? 0 : m_samples[rank];
+        }
+    }
+private:
+    double          m_overhead;
+    double          m_total;
+    uint64_t        m_ops;
+    vector<double>  m_samples;
+};
+
+// splitmix64 of i, picks the keys a find pass looks up
+uint64_t mix(uint64_t i) {
+    uint64_t z = i + 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+template <class T>
+vector<T> parseList(const char* list, T (*parse)(const string&)) {
+    vector<T> values;
+    std::stringstream in(list);
+    string item;
+    while (getline(in, item, ',')) {
+        if (!item.empty()) {
+            values.push_back(parse(item));
+        }
+    }
+    return values;
+}
+
+int toInt(const string& item) { return atoi(item.c_str()); }
+float toFloat(const string& item) { return float(atof(item.c_str())); }
+string toName(const string& item) { return item; }
+
+// every result for one table size and key length
+void runConfig(uint64_t size, int length, const vector<float>& loads,
+               const vector<float>& hitRatios, const vector<const Mode*>& modes,
+               double overhead, vector<Result>& results) {
+    vector<string> hits(size), misses(size);
+    for (uint64_t i = 0; i < size; i++) {
+        hits[i] = sequencer(length, int(i));
+        misses[i] = sequencer(length, int(size + i));
+    }
+    auto hitLoc = [](uint64_t i) { return MINLOCID + int(i % LOCSPAN); };
+    auto missLoc = [](uint64_t i) { return MINLOCID + LOCSPAN + int(i % LOCSPAN); };
+    uint64_t reps = max<uint64_t>(1, (MINOPS + size - 1) / size);
+    for (const Mode* mode : modes) {
+        for (float load : loads) {
+            if (load <= 0 || load >= mode->maxLoad) {
+                continue;
+            }
+            Timer insert(overhead), remove(overhead);
+            vector<Timer> find(hitRatios.size(), Timer(overhead));
+            float actualLoad = 0;
+            for (uint64_t rep = 0; rep < reps; rep++) {
+                DnaDb dnadb(uint64_t(double(size) / load) + 1, nullptr, mode->mode);
+                insert.run(size, [&](uint64_t i) { dnadb.emplace(hits[i], hitLoc(i)); });
+                actualLoad = dnadb.lambda();
+                for (size_t h = 0; h < hitRatios.size(); h++) {
+                    uint64_t threshold = uint64_t(double(hitRatios[h]) * 1000);
+                    const DNA* volatile sink = nullptr;
+                    find[h].run(size, [&](uint64_t i) {
+                        uint64_t pick = mix(rep * size + i);
+                        uint64_t key = pick % size;
+                        sink = (pick >> 40) % 1000 < threshold ? dnadb.find(hits[key], hitLoc(key))
+                                                               : dnadb.find(misses[key], missLoc(key));
+                    });
+                    (void)sink;
+                }
+                remove.run(size, [&](uint64_t i) { dnadb.remove(DNA(hits[i], hitLoc(i))); });
+            }
+            Result result{"", mode, size, length, load, actualLoad, -1, 0, 0, {}};
+            result.op = "insert";
+            insert.report(result);
+            results.push_back(result);
+            for (size_t h = 0; h < hitRatios.size(); h++) {
+                result.op = "find";
+                result.hitRatio = hitRatios[h];
+                find[h].report(result);
+                results.push_back(result);
+            }
+            result.op = "remove";
+            result.hitRatio = -1;
+            remove.report(result);
+            results.push_back(result);
+        }
+    }
+}
+
+string resultName(const Result& R) {
+    ostringstream name;
+    name << R.op;
+    if (R.hitRatio >= 0) {
+        name << "/hit:" << R.hitRatio;
+    }
+    name << "/" << R.mode->name << "/size:" << R.size << "/length:" << R.length
+         << "/load:" << R.load;
+    return name.str();
+}
+
+void writeJson(ostream& out, const vector<Result>& results, double overhead) {
+    char date[64];
+    time_t now = time(nullptr);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+    out << "{\n  \"context\": {\n"
+        << "    \"date\": \"" << date << "\",\n"
+        << "    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n"
+        << "    \"clock_overhead_ns\": " << overhead << ",\n"
+        << "    \"sample_every\": " << SAMPLEEVERY << "\n"
+        << "  },\n  \"benchmarks\": [";
+    for (size_t r = 0; r < results.size(); r++) {
+        const Result& R = results[r];
+        out << (r ? "," : "") << "\n    {\"name\": \"" << resultName(R) << "\", \"op\": \"" << R.op
+            << "\", \"mode\": \"" << R.mode->name << "\", \"size\": " << R.size
+            << ", \"length\": " << R.length << ", \"load\": " << R.load
+            << ", \"actual_load\": " << R.actualLoad << ", \"hit_ratio\": " << R.hitRatio
+            << ", \"iterations\": " << R.ops << ", \"real_time\": " << R.nsPerOp
+            << ", \"time_unit\": \"ns\", \"items_per_second\": "
+            << (R.nsPerOp > 0 ? 1e9 / R.nsPerOp : 0);
+        for (int q = 0; q < 5; q++) {
+            out << ", \"" << QUANTILENAMES[q] << "\": " << R.percentiles[q];
+        }
+        out << "}";
+    }
+    out << "\n  ]\n}" << endl;
+}
+
+void writeCsv(ostream& out, const vector<Result>& results) {
+    out << "name,op,mode,size,length,load,actual_load,hit_ratio,iterations,real_time,"
+        << "items_per_second";
+    for (int q = 0; q < 5; q++) {
+        out << "," << QUANTILENAMES[q];
+    }
+    out << endl;
+    for (const Result& R : results) {
+        out << resultName(R) << "," << R.op << "," << R.mode->name << "," << R.size << ","
+            << R.length << "," << R.load << "," << R.actualLoad << "," << R.hitRatio << ","
+            << R.ops << "," << R.nsPerOp << "," << (R.nsPerOp > 0 ? 1e9 / R.nsPerOp : 0);
+        for (int q = 0; q < 5; q++) {
+            out << "," << R.percentiles[q];
+        }
+        out << endl;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    string format = argc > 1 ? argv[1] : "json";
+    uint64_t maxSize = argc > 2 ? strtoull(argv[2], nullptr, 10) : 1000000;
+    vector<int> lengths = parseList(argc > 3 ? argv[3] : "5,31,150", toInt);
+    vector<float> loads = parseList(argc > 4 ? argv[4] : "0.25,0.45,0.85", toFloat);
+    vector<float> hitRatios = parseList(argc > 5 ? argv[5] : "1,0.5,0", toFloat);
+    vector<string> modeNames = parseList(argc > 6 ? argv[6] : "prime,pow2,swiss,robin", toName);
+    if (format != "json" && format != "csv") {
+        cerr << "usage: dnadbbench [json|csv] [max size] [lengths] [loads] [hit ratios] "
+             << "[modes] [output file]" << endl;
+        return 1;
+    }
+    vector<const Mode*> modes;
+    for (const string& name : modeNames) {
+        for (const Mode& mode : MODES) {
+            if (name == mode.name) {
+                modes.push_back(&mode);
+            }
+        }
+    }
+    double overhead = clockOverhead();
+    vector<Result> results;
+    for (uint64_t size = 1000; size <= maxSize; size *= 10) {
+        for (int length : lengths) {
+            cerr << "size " << size << ", length " << length << endl;
+            runConfig(size, length, loads, hitRatios, modes, overhead, results);
+        }
+    }
+    ofstream file;
+    if (argc > 7) {
+        file.open(argv[7]);
+    }
+    ostream& out = argc > 7 ? file : cout;
+    if (format == "json") {
+        writeJson(out, results, overhead);
+    }
+    else {
+        writeCsv(out, results);
+    }
+    return out.fail() ? 1 : 0;
+}
@@ -0,0 +1,191 @@
+#ifndef DNAHASH_H
+#define DNAHASH_H
+#include <cstdint>
+#include <string_view>
+
+// Built-in key hashes for DnaDb, header only so the per-word steps inline.
+// Each one reads the key as PackedSeq words (2-bit bases, or raw bytes for
+// keys outside ALPHA), so a stored key and a string being looked up hash
+// the same without unpacking or allocating. Every hash is 64 bits and
+// takes a seed; PACKED with seed 0 is the default PackedSeq::hash().
+enum class HASH_KIND {
+    PACKED,     // word-at-a-time multiply and xorshift, one word per step
+    WYHASH,     // wyhash-style 128-bit multiply, two words per step
+    ROLLING     // polynomial over the bases mod 2^61-1, see RollingHash
+};
+
+// Polynomial hash over a key's symbols (base code + 1, or byte + 1 for raw
+// keys) mod the Mersenne prime 2^61-1, with a seeded base. The polynomial
+// can be slid along a longer sequence one base at a time, so every k-mer of
+// a read hashes in O(1). pushFront()/dropBack() slide it the other way,
+// which keeps the reverse complement of a window in step with the window.
+// finish() turns the polynomial into the key hash.
+class RollingHash{
+public:
+    static const uint64_t PRIME = (1ULL << 61) - 1;
+    RollingHash(uint64_t seed);
+    // appends a symbol to the window
+    void push(uint64_t symbol) { m_poly = add(mul(m_poly, m_base), symbol); }
+    // drops the oldest of k symbols, outPower being power(k - 1)
+    void drop(uint64_t symbol, uint64_t outPower) { m_poly = add(m_poly, PRIME - mul(symbol, outPower)); }
+    // prepends a symbol to a window of n symbols, inPower being power(n)
+    void pushFront(uint64_t symbol, uint64_t inPower) { m_poly = add(m_poly, mul(symbol, inPower)); }
+    // drops the newest symbol, baseInverse being inverse()
+    void dropBack(uint64_t symbol, uint64_t baseInverse) {
+        m_poly = mul(add(m_poly, PRIME - symbol), baseInverse);
+    }
+    void reset() { m_poly = 0; }
+    uint64_t poly() const { return m_poly; }
+    uint64_t base() const { return m_base; }
+    // base^n mod PRIME
+    uint64_t power(uint64_t n) const;
+    // base^-1 mod PRIME
+    uint64_t inverse() const { return power(PRIME - 2); }
+    // the hash of a key of length symbols whose polynomial is poly
+    static uint64_t finish(uint64_t poly, uint32_t length, bool packed);
+    // arithmetic mod PRIME
+    static uint64_t add(uint64_t a, uint64_t b);
+    static uint64_t mul(uint64_t a, uint64_t b);
+
+private:
+    uint64_t    m_base;
+    uint64_t    m_poly;
+};
+
+// Feeds a key to one of the hashes a word at a time. The kind is a template
+// parameter so the per-word step of that hash alone inlines into the
+// caller's loop; PackedSeq::hash() picks the instantiation once per key.
+template <HASH_KIND KIND>
+class SeqHasher{
+public:
+    SeqHasher(uint64_t seed, uint32_t length, bool packed);
+    // the key's next word, in order
+    void add(uint64_t word);
+    uint64_t finish();
+
+private:
+    uint32_t    m_length;   // symbols in the key
+    uint32_t    m_left;     // symbols not yet added
+    bool        m_packed;
+    bool        m_odd;      // WYHASH holds an unpaired word in m_pending
+    uint64_t    m_state;
+    uint64_t    m_pending;
+    RollingHash m_rolling;
+};
+
+// wyhash's secrets and its multiply-fold mixer
+const uint64_t WYSECRET[4] = {0xA0761D6478BD642FULL, 0xE7037ED1A0B428DBULL,
+                              0x8EBC6AF09C88C6E3ULL, 0x589965CC75374CC3ULL};
+
+inline uint64_t wymix(uint64_t a, uint64_t b) {
+    unsigned __int128 product = (unsigned __int128)a * b;
+    return uint64_t(product) ^ uint64_t(product >> 64);
+}
+
+// The textbook string hash (val * 33 + c) the project started out with.
+// Tests and benchmarks pass it as the hash_fn of the string key mode.
+inline unsigned int hashCode(std::string_view str) {
+    unsigned int val = 0;
+    const unsigned int thirtyThree = 33;  // magic number from textbook
+    for (size_t i = 0; i < str.length(); i++)
+        val = val * thirtyThree + str[i];
+    return val;
+}
+
+// murmur3 finalizer variant that ends PACKED and ROLLING hashes
+inline uint64_t fmix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+inline RollingHash::RollingHash(uint64_t seed) : m_base(0), m_poly(0) {
+    //splitmix64 of the seed, any base above the largest symbol will do
+    uint64_t z = seed + 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    m_base = 512 + (z ^ (z >> 31)) % (PRIME - 1024);
+}
+
+inline uint64_t RollingHash::add(uint64_t a, uint64_t b) {
+    uint64_t sum = a + b;   //both below 2^61, no overflow
+    return sum >= PRIME ? sum - PRIME : sum;
+}
+
+inline uint64_t RollingHash::mul(uint64_t a, uint64_t b) {
+    //2^61 = 1 mod PRIME, so the high bits fold onto the low ones
+    unsigned __int128 product = (unsigned __int128)a * b;
+    uint64_t folded = (uint64_t(product) & PRIME) + uint64_t(product >> 61);
+    return folded >= PRIME ? folded - PRIME : folded;
+}
+
+inline uint64_t RollingHash::power(uint64_t n) const {
+    uint64_t result = 1, base = m_base;
+    for (; n != 0; n >>= 1) {
+        if (n & 1) {
+            result = mul(result, base);
+        }
+        base = mul(base, base);
+    }
+    return result;
+}
+
+inline uint64_t RollingHash::finish(uint64_t poly, uint32_t length, bool packed) {
+    return fmix(poly ^ ((uint64_t(length) << 1 | packed) * 0x9E3779B97F4A7C15ULL));
+}
+
+template <HASH_KIND KIND>
+inline SeqHasher<KIND>::SeqHasher(uint64_t seed, uint32_t length, bool packed)
+        :m_length(length), m_left(length), m_packed(packed), m_odd(false),
+         m_state(0), m_pending(0), m_rolling(seed)
+{
+    if (KIND == HASH_KIND::PACKED) {
+        m_state = seed ^ (uint64_t(length) << 1 | packed) * 0x9E3779B97F4A7C15ULL;
+    }
+    else if (KIND == HASH_KIND::WYHASH) {
+        m_state = seed ^ wymix(seed ^ WYSECRET[0], WYSECRET[1]);
+    }
+}
+
+template <HASH_KIND KIND>
+inline void SeqHasher<KIND>::add(uint64_t word) {
+    if (KIND == HASH_KIND::PACKED) {
+        m_state = (m_state ^ word) * 0xFF51AFD7ED558CCDULL;
+        m_state ^= m_state >> 32;
+    }
+    else if (KIND == HASH_KIND::WYHASH) {
+        //one 128-bit multiply per pair of words
+        if (m_odd) {
+            m_state = wymix(m_pending ^ WYSECRET[1], word ^ m_state);
+        }
+        m_pending = word;
+        m_odd = !m_odd;
+    }
+    else {
+        int bits = m_packed ? 2 : 8;
+        uint32_t symbols = 64 / bits;
+        uint32_t count = m_left < symbols ? m_left : symbols;
+        for (uint32_t i = 0; i < count; i++) {
+            m_rolling.push(((word >> (bits * i)) & ((1ULL << bits) - 1)) + 1);
+        }
+        m_left -= count;
+    }
+}
+
+template <HASH_KIND KIND>
+inline uint64_t SeqHasher<KIND>::finish() {
+    uint64_t tag = uint64_t(m_length) << 1 | m_packed;
+    if (KIND == HASH_KIND::PACKED) {
+        return fmix(m_state);
+    }
+    if (KIND == HASH_KIND::WYHASH) {
+        if (m_odd) {
+            m_state = wymix(m_pending ^ WYSECRET[1], WYSECRET[2] ^ m_state);
+        }
+        return wymix(WYSECRET[1] ^ tag, m_state ^ WYSECRET[3]);
+    }
+    return RollingHash::finish(m_rolling.poly(), m_length, m_packed);
+}
+
+#endif
@@ -0,0 +1,514 @@
+#ifndef HASHTABLE_H
+#define HASHTABLE_H
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <new>
+#include <utility>
+#include "primetable.h"
+#include "dnahash.h"
+
+// Header-only hash table for indexes other than DnaDb's: open addressing
+// with 1-byte control tags, the full hash of every slot cached next to it,
+// and incremental rehashing into a second table a few slots per
+// insert/erase, as in DnaDb. Key, value, hash functor, probing and growth
+// are template parameters, so the hash and the probe arithmetic inline
+// into the lookup loops. DnaDb keeps its own tables (SWISS groups, arenas,
+// fingerprints, the background migrator) but probes them with the same
+// policies: its PRIME, POWER_OF_TWO and ROBIN_HOOD loops are templates on
+// a Probe and a Growth, instantiated once per mode.
+//
+//   Hash      uint64_t operator()(const K&) for Key and any lookup type K
+//   KeyEqual  bool operator()(const Key&, const K&) for the same types
+//   Probe     LinearProbe, QuadraticProbe or RobinHoodProbe
+//   Growth    PrimeGrowth or PowerOfTwoGrowth<LOADPERCENT>
+//
+// Lookups with another type K (e.g. a string_view for a packed key) work
+// as long as Hash and KeyEqual agree on it. Entries are constructed in
+// place, so neither Key nor Value needs a default constructor. Unlike
+// DnaDb there is no migrator thread: a table is used by one thread at a
+// time.
+
+// Offsets from a key's home slot. Each one stays below the capacity, and
+// on either growth policy's tables reaches an empty slot while the table
+// is within its limit().
+struct LinearProbe {
+    static const bool ROBINHOOD = false;
+    static void next(uint64_t& index, uint64_t& step, uint64_t cap) {
+        (void)step;
+        if (++index == cap) index = 0;
+    }
+};
+
+// Triangular offsets 1, 3, 6, 10...: every slot of a power-of-two table,
+// (cap + 1) / 2 of a prime one
+struct QuadraticProbe {
+    static const bool ROBINHOOD = false;
+    static void next(uint64_t& index, uint64_t& step, uint64_t cap) {
+        index += step;
+        if (index >= cap) index -= cap;
+        if (++step >= cap) step -= cap;
+    }
+};
+
+// Linear probing that keeps every probe sequence ordered by distance from
+// home: an insert takes the slot of any entry closer to its own home, a
+// miss stops at the first entry closer to home than itself, and erase
+// shifts the entries after it back instead of leaving a tombstone.
+struct RobinHoodProbe {
+    static const bool ROBINHOOD = true;
+    static void next(uint64_t& index, uint64_t& step, uint64_t cap) {
+        LinearProbe::next(index, step, cap);
+    }
+};
+
+// PRIMETABLE capacities with fastmod reduction, at most half full (the
+// reach of QuadraticProbe), as DnaDb's PRIME mode
+struct PrimeGrowth {
+    uint64_t    cap = 0;
+    uint128_t   magic = 0;
+    // sizes the table to the first capacity of at least minimum slots
+    // (and at least 16)
+    uint64_t resize(uint64_t minimum) {
+        const PrimeEntry& entry = PRIMETABLE[prime_index(std::max<uint64_t>(minimum, 16) - 1)];
+        cap = entry.prime;
+        magic = entry.magic;
+        return cap;
+    }
+    uint64_t home(uint64_t hash) const { return home(hash, cap, magic); }
+    // the same for a table sized elsewhere (DnaDb's)
+    static uint64_t home(uint64_t hash, uint64_t cap, uint128_t magic) {
+        return fastmod(hash, magic, cap);
+    }
+    // full and deleted slots the table may hold
+    uint64_t limit() const { return (cap - 1) / 2; }
+    // slots for live entries after a rehash, a quarter full
+    static uint64_t next(uint64_t live) { return 4 * live; }
+};
+
+// Power-of-two capacities with a mixed hash and a mask
+template <unsigned LOADPERCENT = 50>
+struct PowerOfTwoGrowth {
+    static_assert(LOADPERCENT > 0 && LOADPERCENT < 100, "a table needs an empty slot");
+    uint64_t    cap = 0;
+    uint64_t resize(uint64_t minimum) {
+        for (cap = 16; cap < minimum; cap <<= 1) {}
+        return cap;
+    }
+    uint64_t home(uint64_t hash) const { return home(hash, cap, 0); }
+    static uint64_t home(uint64_t hash, uint64_t cap, uint128_t) { return fmix(hash) & (cap - 1); }
+    uint64_t limit() const { return uint64_t(uint128_t(cap) * LOADPERCENT / 100); }
+    // half the limit once every live entry has moved over
+    static uint64_t next(uint64_t live) { return live * 200 / LOADPERCENT; }
+};
+
+// for HashTable sets, a value that takes no space of its own
+struct NoValue {};
+
+template <class Key, class Value, class Hash, class Probe, class Growth,
+          class KeyEqual = std::equal_to<Key>>
+class HashTable{
+public:
+    friend class Tester;
+    struct Entry {
+        Key     key;
+        Value   value;
+    };
+    explicit HashTable(uint64_t size = 0, Hash hash = Hash(), KeyEqual equal = KeyEqual());
+    ~HashTable();
+    HashTable(const HashTable&) = delete;
+    HashTable& operator=(const HashTable&) = delete;
+    // false if key is already in the table
+    bool insert(const Key& key, const Value& value = Value());
+    bool insert(Key&& key, Value&& value);
+    // nullptr when absent, valid until the next insert or erase
+    template <class K>
+    Value* find(const K& key);
+    template <class K>
+    const Value* find(const K& key) const;
+    template <class K>
+    const Entry* findEntry(const K& key) const;
+    template <class K>
+    bool contains(const K& key) const { return findEntry(key) != nullptr; }
+    template <class K>
+    bool erase(const K& key);
+    // live entries in both tables
+    uint64_t size() const { return m_cur.used - m_cur.deleted + m_old.used - m_old.deleted; }
+    uint64_t capacity() const { return m_cur.cap; }
+    bool rehashing() const { return m_old.slots != nullptr; }
+    // old slots each insert/erase migrates during a rehash, raised if
+    // needed to finish before the new table fills up, as in DnaDb
+    void setRehashBudget(uint64_t slots);
+    void finishRehash() { if (rehashing()) migrate(m_old.cap); }
+    // visit(key, value) for every entry, in no particular order
+    template <class Visit>
+    void forEach(Visit visit) const;
+
+private:
+    static const int8_t SLOT_EMPTY = -128;
+    static const int8_t SLOT_DELETED = -2;
+    static const int8_t SLOT_FULL = 0;
+
+    struct Table {
+        Entry*      slots = nullptr;    // constructed where ctrl is SLOT_FULL
+        int8_t*     ctrl = nullptr;
+        uint64_t*   hashes = nullptr;   // of full slots, and of deleted ones
+        uint64_t    cap = 0;
+        uint64_t    used = 0;           // full and deleted slots
+        uint64_t    deleted = 0;
+        Growth      growth;
+    };
+
+    Hash        m_hash;
+    KeyEqual    m_equal;
+    Table       m_cur;
+    Table       m_old;          // set while a rehash is in progress
+    uint64_t    m_cursor;       // next old slot to migrate
+    uint64_t    m_step;         // old slots migrated per insert/erase
+    uint64_t    m_budget;       // requested m_step
+
+    void allocate(Table& table, uint64_t size);
+    void release(Table& table);
+    // distance of slot index from the home of the hash cached there
+    uint64_t distance(const Table& table, uint64_t index) const;
+    // index of key in table, or table.cap
+    template <class K>
+    uint64_t lookup(const Table& table, const K& key, uint64_t hash) const;
+    // index of the full slot holding key (returns true), else of the first
+    // deleted or empty slot on its probe sequence
+    template <class K>
+    bool locate(const Table& table, const K& key, uint64_t hash, uint64_t& index) const;
+    template <class K, class V>
+    bool add(K&& key, V&& value);
+    // places an entry known to be absent into the current table
+    void place(Entry&& entry, uint64_t hash);
+    void remove_at(Table& table, uint64_t index, bool shift);
+    void rehash();
+    void migrate(uint64_t slots);
+    void after_write();
+};
+
+template <class Key, class Value, class Hash, class Probe, class Growth, class KeyEqual>
+HashTable<Key, Value, Hash, Probe, Growth, KeyEqual>::HashTable(uint64_t size, Hash hash,
+                                                                KeyEqual equal)
+        :m_hash(hash), m_equal(equal), m_cursor(0), m_step(0), m_budget(16)
+{
+    allocate(m_cur, size);
+}
+
+template <class Key, class Value, class Hash, class Probe, class Growth, class KeyEqual>
+HashTable<Key, Value, Hash, Probe, Growth, KeyEqual>::~HashTable() {
+    release(m_cur);
+    release(m_old);
+}
+
+template <class Key, class Value, class Hash, class Probe, class Growth, class KeyEqual>
+void HashTable<Key, Value, Hash, Probe, Growth, KeyEqual>::allocate(Table& table, uint64_t size) {
+    table.cap = table.growth.resize(size);
+    table.slots = std::allocator<Entry>().allocate(table.cap);
+    table.ctrl = new int8_t[table.cap];
+    memset(table.ctrl, SLOT_EMPTY, table.cap);
+    table.hashes = new uint64_t[table.cap];
+    table.used = 0;
+    table.deleted = 0;
+}
+
+template <class Key, class Value, class Hash, class Probe, class Growth, class KeyEqual>
+void HashTable<Key, Value, Hash, Probe, Growth, KeyEqual>::release(Table& table) {
+    if (table.slots == nullptr) {
+        return;
+    }
+    for (uint64_t i = 0; i < table.cap; i++) {
+        if (table.ctrl[i] == SLOT_FULL) {
+            table.slots[i].~Entry();
+        }
+    }
+    std::allocator<Entry>().deallocate(table.slots, table.cap);
+    delete[] table.ctrl;
+    delete[] table.hashes;
+    table = Table();
+}
+
+template <class Key, class Value, class Hash, class Probe, class Growth, class KeyEqual>
+uint64_t HashTable<Key, Value, Hash, Probe, Growth, KeyEqual>::distance(const Table& table,
+                                                                        uint64_t index) const {
+    uint64_t home = table.growth.home(table.hashes[index]);
+    return index >= home ? index - home : index + table.cap - home;
+}
+
+template <class Key, class Value, class Hash, class Probe, class Growth, class KeyEqual>
+template <class K>
+uint64_t HashTable<Key, Value, Hash, Probe, Growth, KeyEqual>::lookup(const Table& table,
+                                                                      const K& key,
+                                                                      uint64_t hash) const {
+    uint64_t index = table.growth.home(hash);
+    uint64_t step = 1;
+    for (uint64_t probes = 0; table.ctrl[index] != SLOT_EMPTY; probes++) {
+        if (table.ctrl[index] == SLOT_FULL && table.hashes[index] == hash &&
+            m_equal(table.slots[index].key, key)) {
+            return index;
+        }
+        //a deleted slot (only in an old table) still keeps its place in
+        //the order, its hash is cached
+        if (Probe::ROBINHOOD && distance(table, index) < probes) {
+            break;  //key would have taken this slot
+        }
+        Probe::next(index, step, table.cap);
+    }
+    return table.cap;
+}
+
+template <class Key, class Value, class Hash, class Probe, class Growth, class KeyEqual>
+template <class K>
+bool HashTable<Key, Value, Hash, Probe, Growth, KeyEqual>::locate(const Table& table,
+                                                                  const K& key, uint64_t hash,
+                                                                  uint64_t& index) const {
+    index = table.growth.home(hash);
+    uint64_t step = 1;
+    uint64_t freeSlot = table.cap;
+    for (; table.ctrl[index] != SLOT_EMPTY; Probe::next(index, step, table.cap)) {
+        if (table.ctrl[index] == SLOT_DELETED) {
+            if (freeSlot == table.cap) {
+                freeSlot = index;
+            }
+        }
+        else if (table.hashes[index] == hash && m_equal(table.slots[index].key, key)) {
+            return true;
+        }
+    }
+    if (freeSlot != table.cap) {
+        index = freeSlot;
+    }
+    return false;
+}
+
+template <class Key, class Value, class Hash, class Probe, class Growth, class KeyEqual>
+template <class K>
+const typename HashTable<Key, Value, Hash, Probe, Growth, KeyEqual>::Entry*
+HashTable<Key, Value, Hash, Probe, Growth, KeyEqual>::findEntry(const K& key) const {
+    //one hash for both tables, the old one first as in DnaDb
+    uint64_t hash = m_hash(key);
+    if (m_old.slots != nullptr) {
+        uint64_t index = lookup(m_old, key, hash);
+        if (index != m_old.cap) {
+            return &m_old.slots[index];
+        }
+    }
+    uint64_t index = lookup(m_cur, key, hash);
+    return index != m_cur.cap ? &m_cur.slots[index] : nullptr;
+}
+
+template <class Key, class Value, class Hash, class Probe, class Growth, class KeyEqual>
+template <class K>
+const Value* HashTable<Key, Value, Hash, Probe, Growth, KeyEqual>::find(const K& key) const {
+    const Entry* entry = findEntry(key);
+    return entry != nullptr ? &entry->value : nullptr;
+}
+
+template <class Key, class Value, class Hash, class Probe, class Growth, class KeyEqual>
+template <class K>
+Value* HashTable<Key, Value, Hash, Probe, Growth, KeyEqual>::find(const K& key) {
+    return const_cast<Value*>(static_cast<const HashTable*>(this)->find(key));
+}
+
+template <class Key, class Value, class Hash, class Probe, class Growth, class KeyEqual>
+bool HashTable<Key, Value, Hash, Probe, Growth, KeyEqual>::insert(const Key& key,
+                                                                  const Value& value) {
+    return add(key, value);
+}
+
+template <class Key, class Value, class Hash, class Probe, class Growth, class KeyEqual>
+bool HashTable<Key, Value, Hash, Probe, Growth, KeyEqual>::insert(Key&& key, Value&& value) {
+    return add(std::move(key), std::move(value));
+}
+
+template <class Key, class Value, class Hash, class Probe, class Growth, class KeyEqual>
+template <class K, class V>
+bool HashTable<Key, Value, Hash, Probe, Growth, KeyEqual>::add(K&& key, V&& value) {
+    uint64_t hash = m_hash(key);
+    if (m_old.slots != nullptr && lookup(m_old, key, hash) != m_old.cap) {
+        return false;
+    }
+    if (Probe::ROBINHOOD) {
+        if (lookup(m_cur, key, hash) != m_cur.cap) {
+            return false;
+        }
+        place(Entry{std::forward<K>(key), std::forward<V>(value)}, hash);
+    }
+    else {
+        uint64_t index;
+        if (locate(m_cur, key, hash, index)) {
+            return false;
+        }
+        new (&m_cur.slots[index]) Entry{std::forward<K>(key), std::forward<V>(value)};
+        m_cur.hashes[index] = hash;
+        if (m_cur.ctrl[index] == SLOT_DELETED) {
+            m_cur.deleted--;
+        }
+        else {
+            m_cur.used++;
+        }
+        m_cur.ctrl[index] = SLOT_FULL;
+    }
+    after_write();
+    return true;
+}
+
+template <class Key, class Value, class Hash, class Probe, class Growth, class KeyEqual>
+void HashTable<Key, Value, Hash, Probe, Growth, KeyEqual>::place(Entry&& entry, uint64_t hash) {
+    uint64_t index = m_cur.growth.home(hash);
+    uint64_t step = 1;
+    if (Probe::ROBINHOOD) {
+        //the entry being carried swaps places with any entry closer to its
+        //home, which is then carried on
+        Entry carried(std::move(entry));
+        for (uint64_t probes = 0; m_cur.ctrl[index] == SLOT_FULL; probes++) {
+            uint64_t held = distance(m_cur, index);
+            if (held < probes) {
+                std::swap(carried, m_cur.slots[index]);
+                std::swap(hash, m_cur.hashes[index]);
+                probes = held;
+            }
+            Probe::next(index, step, m_cur.cap);
+        }
+        new (&m_cur.slots[index]) Entry(std::move(carried));
+    }
+    else {
+        while (m_cur.ctrl[index] == SLOT_FULL) {
+            Probe::next(index, step, m_cur.cap);
+        }
+        if (m_cur.ctrl[index] == SLOT_DELETED) {
+            m_cur.deleted--;
+            m_cur.used--;
+        }
+        new (&m_cur.slots[index]) Entry(std::move(entry));
+    }
+    m_cur.hashes[index] = hash;
+    m_cur.ctrl[index] = SLOT_FULL;
+    m_cur.used++;
+}
+
+template <class Key, class Value, class Hash, class Probe, class Growth, class KeyEqual>
+template <class K>
+bool HashTable<Key, Value, Hash, Probe, Growth, KeyEqual>::erase(const K& key) {
+    uint64_t hash = m_hash(key);
+    uint64_t index = lookup(m_cur, key, hash);
+    if (index != m_cur.cap) {
+        remove_at(m_cur, index, Probe::ROBINHOOD);
+    }
+    else if (m_old.slots != nullptr && (index = lookup(m_old, key, hash)) != m_old.cap) {
+        //never shift in the old table, entries would slip behind the
+        //migration cursor
+        remove_at(m_old, index, false);
+    }
+    else {
+        return false;
+    }
+    if (m_old.slots != nullptr) {
+        migrate(m_step);
+    }
+    else if (m_cur.used != 0 && m_cur.deleted * 5 > m_cur.used * 4) {
+        rehash();   //over .8 of the used slots are deleted, as in DnaDb
+    }
+    return true;
+}
+
+template <class Key, class Value, class Hash, class Probe, class Growth, class KeyEqual>
+void HashTable<Key, Value, Hash, Probe, Growth, KeyEqual>::remove_at(Table& table,
+                                                                     uint64_t index,
+                                                                     bool shift) {
+    table.slots[index].~Entry();
+    if (!shift) {
+        table.ctrl[index] = SLOT_DELETED;
+        table.deleted++;
+        return;
+    }
+    //backward shift: pull each following entry that is away from home
+    //one slot closer, until an empty slot or an entry at home
+    uint64_t hole = index;
+    uint64_t step = 1;
+    Probe::next(index, step, table.cap);
+    while (table.ctrl[index] == SLOT_FULL && distance(table, index) != 0) {
+        new (&table.slots[hole]) Entry(std::move(table.slots[index]));
+        table.slots[index].~Entry();
+        table.hashes[hole] = table.hashes[index];
+        table.ctrl[hole] = SLOT_FULL;
+        hole = index;
+        Probe::next(index, step, table.cap);
+    }
+    table.ctrl[hole] = SLOT_EMPTY;
+    table.used--;
+}
+
+template <class Key, class Value, class Hash, class Probe, class Growth, class KeyEqual>
+void HashTable<Key, Value, Hash, Probe, Growth, KeyEqual>::after_write() {
+    if (m_old.slots != nullptr) {
+        migrate(m_step);
+    }
+    //rehash while there is still room for the next insert
+    if (m_old.slots == nullptr && m_cur.used + 1 > m_cur.growth.limit()) {
+        rehash();
+    }
+}
+
+template <class Key, class Value, class Hash, class Probe, class Growth, class KeyEqual>
+void HashTable<Key, Value, Hash, Probe, Growth, KeyEqual>::rehash() {
+    //the current table becomes the old one, migrate() then moves its
+    //entries over m_step slots per insert/erase
+    uint64_t live = m_cur.used - m_cur.deleted;
+    m_old = m_cur;
+    m_cur = Table();
+    allocate(m_cur, Growth::next(live));
+    m_cursor = 0;
+    //inserts left before the new table passes its limit once every old
+    //entry has landed in it, the step must drain the old table by then
+    uint64_t limit = m_cur.growth.limit();
+    uint64_t headroom = limit > live ? limit - live : 1;
+    m_step = std::max(m_budget, (m_old.cap + headroom - 1) / headroom);
+    migrate(m_step);
+}
+
+template <class Key, class Value, class Hash, class Probe, class Growth, class KeyEqual>
+void HashTable<Key, Value, Hash, Probe, Growth, KeyEqual>::migrate(uint64_t slots) {
+    //resumes at the cursor, so every old slot is visited exactly once; the
+    //cached hash re-indexes each entry without hashing its key again
+    uint64_t end = std::min(m_old.cap, m_cursor + slots);
+    for (uint64_t j = m_cursor; j < end; j++) {
+        if (m_old.ctrl[j] == SLOT_FULL) {
+            place(std::move(m_old.slots[j]), m_old.hashes[j]);
+            m_old.slots[j].~Entry();
+            m_old.ctrl[j] = SLOT_DELETED;
+            m_old.deleted++;
+        }
+    }
+    m_cursor = end;
+    if (m_cursor == m_old.cap) {
+        release(m_old);
+        m_cursor = 0;
+    }
+}
+
+template <class Key, class Value, class Hash, class Probe, class Growth, class KeyEqual>
+void HashTable<Key, Value, Hash, Probe, Growth, KeyEqual>::setRehashBudget(uint64_t slots) {
+    m_budget = std::max<uint64_t>(1, slots);
+    if (m_old.slots != nullptr) {
+        m_step = std::max(m_step, m_budget);
+    }
+}
+
+template <class Key, class Value, class Hash, class Probe, class Growth, class KeyEqual>
+template <class Visit>
+void HashTable<Key, Value, Hash, Probe, Growth, KeyEqual>::forEach(Visit visit) const {
+    for (const Table* table : {&m_old, &m_cur}) {
+        for (uint64_t i = 0; i < table->cap; i++) {
+            if (table->ctrl[i] == SLOT_FULL) {
+                visit(table->slots[i].key, table->slots[i].value);
+            }
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,410 @@
+#include "lockfreednadb.h"
+#include <thread>
+
+// node pointers are at least 8 byte aligned, so the low bits hold flags
+static bool is_node(uintptr_t slot) {
+    return (slot & ~uintptr_t(3)) > 4;
+}
+
+LockFreeDnaDb::Table::Table(uint64_t size) {
+    const PrimeEntry& entry = PRIMETABLE[prime_index(size - 1)];
+    cap = entry.prime;
+    magic = entry.magic;
+    //quadratic probing on a prime table reaches (cap + 1) / 2 distinct
+    //slots, so one of them is still empty below this
+    limit = (cap - 1) / 2;
+    used = 0;
+    deleted = 0;
+    slots = new std::atomic<uintptr_t>[cap];
+    for (uint64_t i = 0; i < cap; i++) {
+        slots[i].store(SLOT_EMPTY, std::memory_order_relaxed);
+    }
+}
+
+LockFreeDnaDb::Table::~Table() {
+    delete[] slots;
+}
+
+LockFreeDnaDb::LockFreeDnaDb(uint64_t size, hash_fn hash)
+        :m_hash(hash), m_current(new Table(max<uint64_t>(size, MINPRIME))), m_old(nullptr),
+         m_live(0), m_reserved(0), m_migrateCursor(0), m_migrated(0), m_epoch(0)
+{
+    for (int i = 0; i < READERSTRIPES; i++) {
+        m_readers[i].count[0] = 0;
+        m_readers[i].count[1] = 0;
+    }
+}
+
+LockFreeDnaDb::~LockFreeDnaDb() {
+    //no other thread may be using the table any more
+    Table* cur = m_current.load();
+    Table* old = m_old.load();
+    for (uint64_t i = 0; i < cur->cap; i++) {
+        uintptr_t slot = cur->slots[i].load();
+        if (is_node(slot)) {
+            delete (Node*)(slot & ~SLOT_FLAGS);
+        }
+    }
+    if (old != nullptr) {
+        //copied nodes were freed with the current table
+        for (uint64_t i = 0; i < old->cap; i++) {
+            uintptr_t slot = old->slots[i].load();
+            if (is_node(slot) && (slot & SLOT_COPIED) == 0) {
+                delete (Node*)(slot & ~SLOT_FLAGS);
+            }
+        }
+        delete old;
+    }
+    delete cur;
+    for (Node* node : m_retired) {
+        delete node;
+    }
+}
+
+LockFreeDnaDb::KeyRef LockFreeDnaDb::key_of(const DNA& dna) const {
+    KeyRef key{&dna.m_sequence, string_view(), dna.m_location, 0};
+    key.hash = m_hash == nullptr ? dna.m_sequence.hash() : m_hash(dna.getSequence());
+    return key;
+}
+
+LockFreeDnaDb::KeyRef LockFreeDnaDb::key_of(string_view sequence, int location) const {
+    KeyRef key{nullptr, sequence, location, 0};
+    key.hash = m_hash == nullptr ? PackedSeq::hash(sequence) : m_hash(sequence);
+    return key;
+}
+
+bool LockFreeDnaDb::matches(uintptr_t slot, const KeyRef& key) const {
+    const Node* node = (const Node*)(slot & ~SLOT_FLAGS);
+    if (node->hash != key.hash || node->dna.m_location != key.location) {
+        return false;
+    }
+    if (key.packed != nullptr) {
+        return node->dna.m_sequence == *key.packed;
+    }
+    return node->dna.m_sequence.equals(key.view);
+}
+
+uint64_t LockFreeDnaDb::probe(const Table* table, const KeyRef& key, uintptr_t& slot) const {
+    //quadratic offsets 1, 4, 9..., (cap + 1) / 2 slots of a prime table
+    uint64_t index = fastmod(key.hash, table->magic, table->cap);
+    uint64_t step = 1;
+    while (true) {
+        slot = table->slots[index].load(std::memory_order_acquire);
+        if ((slot & ~SLOT_FLAGS) == SLOT_EMPTY) {
+            return index;
+        }
+        if (slot != SLOT_DELETED && matches(slot, key)) {
+            return index;
+        }
+        index += step;
+        if (index >= table->cap) index -= table->cap;
+        step += 2;
+        if (step >= table->cap) step -= table->cap;
+    }
+}
+
+const LockFreeDnaDb::Node* LockFreeDnaDb::lookup(const KeyRef& key) const {
+    //must run inside a read epoch, which keeps both tables alive. One
+    //probe of each table at most and no retry, so lookups are wait-free.
+    //m_current is loaded before m_old: a resize publishes m_old first and
+    //clears it only once every entry is copied, so whatever table cur is,
+    //an entry missing from it is in the old table loaded after it, or was
+    //inserted while we looked. Entries stay in an old table until it is
+    //retired, so checking it first never misses one being copied.
+    Table* cur = m_current.load();
+    Table* old = m_old.load();
+    uintptr_t slot;
+    if (old != nullptr && old != cur) {
+        probe(old, key, slot);
+        if (is_node(slot)) {
+            return (const Node*)(slot & ~SLOT_FLAGS);
+        }
+    }
+    probe(cur, key, slot);
+    if (is_node(slot)) {
+        return (const Node*)(slot & ~SLOT_FLAGS);
+    }
+    return nullptr;
+}
+
+bool LockFreeDnaDb::contains(string_view sequence, int location) const {
+    if (location < MINLOCID || location > MAXLOCID) { //if bad location id
+        return false;
+    }
+    int epoch = enter_read();
+    bool found = lookup(key_of(sequence, location)) != nullptr;
+    exit_read(epoch);
+    return found;
+}
+
+DNA LockFreeDnaDb::getDNA(string_view sequence, int location) const {
+    if (location < MINLOCID || location > MAXLOCID) { //if bad location id
+        return EMPTY;
+    }
+    int epoch = enter_read();
+    const Node* node = lookup(key_of(sequence, location));
+    DNA result = node != nullptr ? node->dna : EMPTY;
+    exit_read(epoch);
+    return result;
+}
+
+uint64_t LockFreeDnaDb::capacity() const {
+    int epoch = enter_read();
+    uint64_t cap = m_current.load()->cap;
+    exit_read(epoch);
+    return cap;
+}
+
+bool LockFreeDnaDb::insert(const DNA& dna) {
+    if (dna.m_location < MINLOCID || dna.m_location > MAXLOCID) {
+        //bad location, reject insert operation
+        return false;
+    }
+    Node* node = new Node{dna, key_of(dna).hash};
+    if (!insert_node(node)) {
+        delete node;
+        return false;
+    }
+    m_live++;
+    help_migrate();
+    return true;
+}
+
+bool LockFreeDnaDb::reserve(Table* table) {
+    //claims room for one more non-empty slot, false if the table is full
+    if (table->used.fetch_add(1) + 1 > table->limit) {
+        table->used--;
+        return false;
+    }
+    return true;
+}
+
+bool LockFreeDnaDb::insert_node(Node* node) {
+    KeyRef key{&node->dna.m_sequence, string_view(), node->dna.m_location, node->hash};
+    int epoch = enter_read();
+    while (true) {
+        Table* old = m_old.load();
+        Table* cur = m_current.load();
+        if (m_old.load() != old) {
+            continue;   //a resize started or finished between the loads
+        }
+        uintptr_t slot;
+        if (old != nullptr) {
+            //Writers that loaded the old table as current before the resize
+            //can still insert into it. The key would go to the first empty
+            //slot of its sequence, so freezing that slot shuts them out
+            //(they retry in the new table) and finding the key there means
+            //one of them won.
+            uint64_t index = probe(old, key, slot);
+            if (is_node(slot)) {
+                exit_read(epoch);
+                return false;
+            }
+            if (slot == SLOT_EMPTY &&
+                !old->slots[index].compare_exchange_strong(slot, SLOT_FROZEN)) {
+                continue;
+            }
+        }
+        if (!reserve(cur)) {
+            //growing can wait for readers, so leave the epoch first
+            exit_read(epoch);
+            grow(cur);
+            epoch = enter_read();
+            continue;
+        }
+        uint64_t index = probe(cur, key, slot);
+        if (is_node(slot)) {
+            cur->used--;
+            exit_read(epoch);
+            return false;
+        }
+        //a frozen slot means cur is being resized, retry in the new table
+        if (slot == SLOT_EMPTY &&
+            cur->slots[index].compare_exchange_strong(slot, uintptr_t(node))) {
+            exit_read(epoch);
+            return true;
+        }
+        cur->used--;
+    }
+}
+
+bool LockFreeDnaDb::remove(const DNA& dna) {
+    if (dna.m_location < MINLOCID || dna.m_location > MAXLOCID) {
+        //bad location, reject remove operation
+        return false;
+    }
+    KeyRef key = key_of(dna);
+    Node* removed = nullptr;
+    int epoch = enter_read();
+    while (true) {
+        Table* old = m_old.load();
+        Table* cur = m_current.load();
+        if (m_old.load() != old) {
+            continue;
+        }
+        uintptr_t slot;
+        if (old != nullptr) {
+            uint64_t index = probe(old, key, slot);
+            if (is_node(slot) && (slot & SLOT_FROZEN) == 0) {
+                //not visited by the resize yet, the old slot is the entry
+                if (old->slots[index].compare_exchange_strong(slot, SLOT_DELETED)) {
+                    old->deleted++;
+                    removed = (Node*)slot;
+                    break;
+                }
+                continue;
+            }
+            if (is_node(slot) && (slot & SLOT_COPIED) == 0) {
+                std::this_thread::yield();  //the migrator is copying it
+                continue;
+            }
+            if (is_node(slot)) {
+                //hide the old copy, the new table decides who removed it
+                old->slots[index].compare_exchange_strong(slot, SLOT_DELETED);
+            }
+        }
+        uint64_t index = probe(cur, key, slot);
+        if (!is_node(slot)) {
+            break;
+        }
+        //fails if another remove won or cur has started a resize since
+        if (cur->slots[index].compare_exchange_strong(slot, SLOT_DELETED)) {
+            cur->deleted++;
+            removed = (Node*)(slot & ~SLOT_FLAGS);
+            break;
+        }
+    }
+    exit_read(epoch);
+    if (removed == nullptr) {
+        return false;
+    }
+    m_live--;
+    retire(removed);
+    help_migrate();
+    return true;
+}
+
+void LockFreeDnaDb::grow(Table* full) {
+    std::lock_guard<std::mutex> guard(m_resizeLock);
+    if (m_current.load() != full) {
+        return;     //someone else grew it
+    }
+    if (m_old.load() != nullptr) {
+        //inserts outran the migration, finish it before starting another
+        migrate(m_old.load()->cap);
+    }
+    if (full->used.load() >= full->limit) {
+        start_resize(full);
+    }
+}
+
+void LockFreeDnaDb::start_resize(Table* full) {
+    //m_resizeLock is held. The full table's reserved slots that are not
+    //tombstones bound the entries it can still hold: those already in it
+    //plus inserts in flight (the table is full, no new ones can start).
+    //They are reserved in the new table up front, so inserts racing the
+    //migration cannot fill it before the old entries have landed. The
+    //new table is sized from them alone, so a table full of tombstones
+    //compacts into one of the same size rather than doubling.
+    uint64_t entries = full->used.load() - full->deleted.load();
+    Table* next = new Table(max<uint64_t>(4 * entries, MINPRIME));
+    next->used = entries;
+    m_reserved = entries;
+    m_migrateCursor = 0;
+    m_migrated = 0;
+    m_old.store(full);
+    m_current.store(next);
+    migrate(LOCKFREECHUNK);
+}
+
+void LockFreeDnaDb::migrate(uint64_t slots) {
+    //m_resizeLock is held, so this is the only thread copying
+    Table* old = m_old.load();
+    Table* cur = m_current.load();
+    uint64_t end = min(old->cap, m_migrateCursor + slots);
+    for (uint64_t j = m_migrateCursor; j < end; j++) {
+        uintptr_t slot = old->slots[j].load();
+        //freeze the slot so nothing more can be inserted in it
+        while (slot != SLOT_DELETED &&
+               !old->slots[j].compare_exchange_weak(slot, slot | SLOT_FROZEN)) {
+        }
+        if (!is_node(slot)) {
+            continue;
+        }
+        Node* node = (Node*)slot;
+        KeyRef key{&node->dna.m_sequence, string_view(), node->dna.m_location, node->hash};
+        uintptr_t target;
+        uint64_t index = probe(cur, key, target);
+        while (!cur->slots[index].compare_exchange_strong(target, slot)) {
+            index = probe(cur, key, target);    //an insert took the slot
+        }
+        old->slots[j].store(slot | SLOT_FROZEN | SLOT_COPIED);
+        m_migrated++;
+    }
+    m_migrateCursor = end;
+    if (m_migrateCursor == old->cap) {
+        //return what was reserved for inserts that gave up on the old table
+        cur->used -= m_reserved - m_migrated;
+        m_old.store(nullptr);
+        wait_for_readers();
+        delete old;
+    }
+}
+
+void LockFreeDnaDb::help_migrate() {
+    //writers share the migration, but never wait for each other to do it
+    if (m_old.load() != nullptr && m_resizeLock.try_lock()) {
+        if (m_old.load() != nullptr) {
+            migrate(LOCKFREECHUNK);
+        }
+        m_resizeLock.unlock();
+    }
+}
+
+void LockFreeDnaDb::retire(Node* node) {
+    //frees removed nodes in batches, one grace period per batch
+    std::vector<Node*> batch;
+    {
+        std::lock_guard<std::mutex> guard(m_retireLock);
+        m_retired.push_back(node);
+        if (m_retired.size() < RETIREBATCH) {
+            return;
+        }
+        batch.swap(m_retired);
+    }
+    wait_for_readers();
+    for (Node* retired : batch) {
+        delete retired;
+    }
+}
+
+int LockFreeDnaDb::enter_read() const {
+    //threads spread over the stripes so readers do not share a counter
+    static std::atomic<unsigned> nextStripe(0);
+    thread_local unsigned stripe = nextStripe++ % READERSTRIPES;
+    std::atomic<int64_t>* count = m_readers[stripe].count;
+    while (true) {
+        uint64_t epoch = m_epoch.load();
+        int parity = int(epoch & 1);
+        count[parity]++;
+        if (m_epoch.load() == epoch) {
+            return int(stripe) * 2 + parity;
+        }
+        count[parity]--;    //raced with a flip, register again
+    }
+}
+
+void LockFreeDnaDb::exit_read(int ticket) const {
+    m_readers[ticket / 2].count[ticket % 2]--;
+}
+
+void LockFreeDnaDb::wait_for_readers() {
+    //as DnaDb::wait_for_readers, summed over the stripes
+    std::lock_guard<std::mutex> guard(m_graceLock);
+    int parity = int(m_epoch.fetch_add(1) & 1);
+    for (int i = 0; i < READERSTRIPES; i++) {
+        while (m_readers[i].count[parity].load() != 0) {
+            std::this_thread::yield();
+        }
+    }
+}
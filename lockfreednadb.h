@@ -0,0 +1,117 @@
+#ifndef LOCKFREEDNADB_H
+#define LOCKFREEDNADB_H
+#include "dnadb.h"
+#include <vector>
+#include <atomic>
+#include <mutex>
+
+const int READERSTRIPES = 64;       // reader counters, spread over cache lines
+const uint64_t RETIREBATCH = 256;   // removed entries freed per grace period
+const uint64_t LOCKFREECHUNK = 64;  // old slots a writer migrates per operation
+
+// A read-optimized DnaDb for many threads. Lookups take no locks and are
+// wait-free, one probe of each table at most: every slot is an atomic
+// pointer to an immutable heap node, published with a single CAS, so
+// readers only ever see empty, deleted or complete entries. insert and
+// remove are CAS based too, but retry when they lose a slot to another
+// writer or a resize, and the insert that finds the table full takes the
+// resize lock to start the next one. Growth keeps the current/old table
+// design of DnaDb: a resize publishes a new table and writers migrate the
+// old one a chunk at a time, while readers consult both. Removed nodes and
+// retired tables are freed only after every reader that could still see
+// them has left (two-parity epochs, as in DnaDb's background rehash).
+//
+// Tables use PRIME sizing with quadratic probing and stay at most half
+// full, so every probe sequence reaches an empty slot. Deleted slots are
+// not reused, only dropped by the next resize, which sizes the new table
+// for the live entries: under remove/insert churn it compacts instead of
+// growing.
+class LockFreeDnaDb{
+public:
+    friend class Tester;
+    // a null hash selects packed keys, as in DnaDb
+    LockFreeDnaDb(uint64_t size, hash_fn hash);
+    ~LockFreeDnaDb();
+    LockFreeDnaDb(const LockFreeDnaDb&) = delete;
+    LockFreeDnaDb& operator=(const LockFreeDnaDb&) = delete;
+    bool insert(const DNA& dna);
+    bool remove(const DNA& dna);
+    bool contains(string_view sequence, int location) const;
+    // returns EMPTY when absent
+    DNA getDNA(string_view sequence, int location) const;
+    // number of live entries and slots in the current table
+    uint64_t size() const { return m_live.load(); }
+    uint64_t capacity() const;
+
+private:
+    // an entry never changes once published
+    struct Node {
+        DNA         dna;
+        uint64_t    hash;
+    };
+    // Slot values: 0 is empty and DELETED is a tombstone, anything else is
+    // a Node pointer. A resize sets FROZEN on every slot it has visited so
+    // that no more inserts land in the old table, and COPIED once the
+    // node is also in the new one.
+    static const uintptr_t SLOT_EMPTY = 0;
+    static const uintptr_t SLOT_FROZEN = 1;
+    static const uintptr_t SLOT_COPIED = 2;
+    static const uintptr_t SLOT_DELETED = 4;
+    static const uintptr_t SLOT_FLAGS = SLOT_FROZEN | SLOT_COPIED;
+    struct Table {
+        std::atomic<uintptr_t>*  slots;
+        uint64_t                 cap;
+        uint128_t                magic;  // fastmod magic of cap
+        uint64_t                 limit;  // most non-empty slots allowed
+        std::atomic<uint64_t>    used;   // non-empty slots, reserved before use
+        std::atomic<uint64_t>    deleted;// of those, tombstones
+        Table(uint64_t size);
+        ~Table();
+    };
+    struct alignas(64) ReaderStripe {
+        std::atomic<int64_t>     count[2];  // readers per epoch parity
+    };
+    // a key being probed for, as DnaDb::KeyRef
+    struct KeyRef {
+        const PackedSeq*    packed;
+        string_view         view;
+        int                 location;
+        uint64_t            hash;
+    };
+
+    hash_fn                 m_hash;
+    std::atomic<Table*>     m_current;
+    std::atomic<Table*>     m_old;      // set while a resize is in progress
+    std::atomic<uint64_t>   m_live;
+    // resize state, only touched with m_resizeLock held
+    std::mutex              m_resizeLock;
+    uint64_t                m_reserved;     // new table slots held for old entries
+    uint64_t                m_migrateCursor;
+    uint64_t                m_migrated;
+    // reclamation
+    std::atomic<uint64_t>   m_epoch;
+    mutable ReaderStripe    m_readers[READERSTRIPES];
+    std::mutex              m_retireLock;
+    std::vector<Node*>      m_retired;
+    std::mutex              m_graceLock;    // one grace period at a time
+
+    KeyRef key_of(const DNA& dna) const;
+    KeyRef key_of(string_view sequence, int location) const;
+    bool matches(uintptr_t slot, const KeyRef& key) const;
+    // Probes table for key. Returns the index of the slot holding it, or of
+    // the first empty (or frozen empty) slot, and that slot's value.
+    uint64_t probe(const Table* table, const KeyRef& key, uintptr_t& slot) const;
+    const Node* lookup(const KeyRef& key) const;
+    bool insert_node(Node* node);
+    bool reserve(Table* table);
+    void grow(Table* full);
+    void start_resize(Table* full);
+    void migrate(uint64_t slots);
+    void help_migrate();
+    void retire(Node* node);
+    int enter_read() const;
+    void exit_read(int parity) const;
+    void wait_for_readers();
+};
+
+#endif
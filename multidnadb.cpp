@@ -0,0 +1,333 @@
+#include "multidnadb.h"
+#include <cstring>
+
+// 7 bits per byte, high bit set on all but the last byte
+static uint32_t encode_varint(uint32_t value, uint8_t* out) {
+    uint32_t n = 0;
+    while (value >= 0x80) {
+        out[n++] = uint8_t(value | 0x80);
+        value >>= 7;
+    }
+    out[n++] = uint8_t(value);
+    return n;
+}
+
+static uint32_t decode_varint(const uint8_t* in, uint32_t& value) {
+    uint32_t n = 0;
+    value = 0;
+    for (int shift = 0; ; shift += 7) {
+        uint8_t byte = in[n++];
+        value |= uint32_t(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return n;
+        }
+    }
+}
+
+PostingList::PostingList() : m_inline{}, m_count(0), m_used(0), m_capacity(POSTINGINLINE) {}
+
+PostingList::~PostingList() {
+    release();
+}
+
+PostingList::PostingList(PostingList&& rhs) noexcept
+        :m_count(rhs.m_count), m_used(rhs.m_used), m_capacity(rhs.m_capacity)
+{
+    memcpy(m_inline, rhs.m_inline, POSTINGINLINE);  //the bytes or the pointer
+    rhs.m_count = 0;
+    rhs.m_used = 0;
+    rhs.m_capacity = POSTINGINLINE;
+}
+
+PostingList& PostingList::operator=(PostingList&& rhs) noexcept {
+    if (this != &rhs) {
+        release();
+        memcpy(m_inline, rhs.m_inline, POSTINGINLINE);
+        m_count = rhs.m_count;
+        m_used = rhs.m_used;
+        m_capacity = rhs.m_capacity;
+        rhs.m_count = 0;
+        rhs.m_used = 0;
+        rhs.m_capacity = POSTINGINLINE;
+    }
+    return *this;
+}
+
+void PostingList::release() {
+    if (m_capacity > POSTINGINLINE) {
+        delete[] m_bytes;
+    }
+    m_count = 0;
+    m_used = 0;
+    m_capacity = POSTINGINLINE;
+}
+
+bool PostingList::seek(int location, uint32_t& pos, int& prev, int& value, uint32_t& len) const {
+    const uint8_t* bytes = data();
+    prev = MINLOCID;
+    for (pos = 0; pos < m_used; pos += len) {
+        uint32_t delta;
+        len = decode_varint(bytes + pos, delta);
+        value = prev + int(delta);
+        if (value >= location) {
+            return true;
+        }
+        prev = value;
+    }
+    len = 0;
+    return false;
+}
+
+void PostingList::splice(uint32_t pos, uint32_t len, const uint8_t* with, uint32_t n) {
+    uint32_t used = m_used - len + n;
+    if (used > m_capacity) {
+        //at most two bytes per location, so 16 bits always suffice
+        uint32_t capacity = max<uint32_t>(used, 2 * m_capacity);
+        uint8_t* grown = new uint8_t[capacity];
+        memcpy(grown, data(), m_used);
+        if (m_capacity > POSTINGINLINE) {
+            delete[] m_bytes;
+        }
+        m_bytes = grown;
+        m_capacity = uint16_t(capacity);
+    }
+    uint8_t* bytes = data();
+    memmove(bytes + pos + n, bytes + pos + len, m_used - pos - len);
+    memcpy(bytes + pos, with, n);
+    m_used = uint16_t(used);
+}
+
+bool PostingList::contains(int location) const {
+    uint32_t pos, len;
+    int prev, value;
+    return seek(location, pos, prev, value, len) && value == location;
+}
+
+bool PostingList::insert(int location) {
+    uint32_t pos, len;
+    int prev, value;
+    bool before = seek(location, pos, prev, value, len);
+    if (before && value == location) {
+        return false;
+    }
+    //the delta from prev to location, and the one from location on to the
+    //next location replacing that location's old delta
+    uint8_t with[10];
+    uint32_t n = encode_varint(uint32_t(location - prev), with);
+    if (before) {
+        n += encode_varint(uint32_t(value - location), with + n);
+    }
+    splice(pos, len, with, n);
+    m_count++;
+    return true;
+}
+
+bool PostingList::remove(int location) {
+    uint32_t pos, len;
+    int prev, value;
+    if (!seek(location, pos, prev, value, len) || value != location) {
+        return false;
+    }
+    //the next location's delta now starts from prev
+    uint8_t with[5];
+    uint32_t n = 0;
+    if (pos + len < m_used) {
+        uint32_t delta;
+        len += decode_varint(data() + pos + len, delta);
+        n = encode_varint(uint32_t(location + int(delta) - prev), with);
+    }
+    splice(pos, len, with, n);
+    m_count--;
+    return true;
+}
+
+MultiDnaDb::MultiDnaDb(uint64_t size, hash_fn hash)
+        :m_hash(hash), m_keys(nullptr), m_postings(nullptr), m_ctrl(nullptr), m_hashes(nullptr),
+         m_cap(0), m_magic(0), m_size(0), m_numDeleted(0), m_entries(0)
+{
+    allocate(max<uint64_t>(size, MINPRIME));
+}
+
+MultiDnaDb::~MultiDnaDb() {
+    delete[] m_keys;
+    delete[] m_postings;
+    delete[] m_ctrl;
+    delete[] m_hashes;
+}
+
+void MultiDnaDb::allocate(uint64_t size) {
+    const PrimeEntry& entry = PRIMETABLE[prime_index(size - 1)];
+    m_cap = entry.prime;
+    m_magic = entry.magic;
+    m_keys = new PackedSeq[m_cap];
+    m_postings = new PostingList[m_cap];
+    m_ctrl = new int8_t[m_cap];
+    memset(m_ctrl, CTRL_EMPTY, m_cap);
+    m_hashes = new uint64_t[m_cap];
+    m_size = 0;
+    m_numDeleted = 0;
+}
+
+MultiDnaDb::KeyRef MultiDnaDb::key_of(const PackedSeq& sequence) const {
+    KeyRef key{&sequence, string_view(), 0};
+    key.hash = m_hash == nullptr ? sequence.hash() : m_hash(sequence.toString());
+    return key;
+}
+
+MultiDnaDb::KeyRef MultiDnaDb::key_of(string_view sequence) const {
+    KeyRef key{nullptr, sequence, 0};
+    key.hash = m_hash == nullptr ? PackedSeq::hash(sequence) : m_hash(sequence);
+    return key;
+}
+
+uint64_t MultiDnaDb::probe(const KeyRef& key) const {
+    //quadratic offsets 1, 4, 9..., (cap + 1) / 2 slots of a prime table
+    uint64_t index = fastmod(key.hash, m_magic, m_cap);
+    uint64_t step = 1;
+    uint64_t freeSlot = m_cap;
+    for (; m_ctrl[index] != CTRL_EMPTY; ) {
+        if (m_ctrl[index] == CTRL_DELETED) {
+            if (freeSlot == m_cap) {
+                freeSlot = index;
+            }
+        }
+        else if (m_hashes[index] == key.hash &&
+                 (key.packed != nullptr ? m_keys[index] == *key.packed
+                                        : m_keys[index].equals(key.view))) {
+            return index;
+        }
+        index += step;
+        if (index >= m_cap) index -= m_cap;
+        step += 2;
+        if (step >= m_cap) step -= m_cap;
+    }
+    return freeSlot == m_cap ? index : freeSlot;
+}
+
+bool MultiDnaDb::insert(const DNA& dna) {
+    if (dna.m_location < MINLOCID || dna.m_location > MAXLOCID) {
+        //bad location, reject insert operation
+        return false;
+    }
+    return add(key_of(dna.m_sequence), dna.m_location);
+}
+
+bool MultiDnaDb::emplace(string_view sequence, int location) {
+    if (location < MINLOCID || location > MAXLOCID) {
+        //bad location, reject insert operation
+        return false;
+    }
+    return add(key_of(sequence), location);
+}
+
+bool MultiDnaDb::add(const KeyRef& key, int location) {
+    uint64_t index = probe(key);
+    if (m_ctrl[index] == CTRL_FULL) {
+        //a known sequence, no new slot
+        if (!m_postings[index].insert(location)) {
+            return false;
+        }
+        m_entries++;
+        return true;
+    }
+    if (key.packed != nullptr) {
+        m_keys[index].assign(*key.packed, m_arena);
+    }
+    else {
+        m_keys[index].assign(key.view, m_arena);
+    }
+    m_postings[index].insert(location);
+    m_hashes[index] = key.hash;
+    if (m_ctrl[index] == CTRL_DELETED) {
+        m_numDeleted--;
+    }
+    else {
+        m_size++;
+    }
+    m_ctrl[index] = CTRL_FULL;
+    m_entries++;
+    //quadratic probing reaches (cap + 1) / 2 slots, one has to stay empty
+    if (m_size + 1 > (m_cap - 1) / 2) {
+        rehash();
+    }
+    return true;
+}
+
+bool MultiDnaDb::remove(const DNA& dna) {
+    if (dna.m_location < MINLOCID || dna.m_location > MAXLOCID) { //if bad location id
+        return false;
+    }
+    uint64_t index = probe(key_of(dna.m_sequence));
+    if (m_ctrl[index] != CTRL_FULL || !m_postings[index].remove(dna.m_location)) {
+        return false;
+    }
+    m_entries--;
+    if (m_postings[index].empty()) {
+        m_postings[index] = PostingList();  //give back its bytes now
+        m_ctrl[index] = CTRL_DELETED;
+        m_numDeleted++;
+    }
+    return true;
+}
+
+bool MultiDnaDb::contains(string_view sequence, int location) const {
+    if (location < MINLOCID || location > MAXLOCID) { //if bad location id
+        return false;
+    }
+    uint64_t index = probe(key_of(sequence));
+    return m_ctrl[index] == CTRL_FULL && m_postings[index].contains(location);
+}
+
+vector<int> MultiDnaDb::getLocations(string_view sequence) const {
+    vector<int> locations;
+    uint64_t index = probe(key_of(sequence));
+    if (m_ctrl[index] == CTRL_FULL) {
+        locations.reserve(m_postings[index].size());
+        m_postings[index].forEach([&locations](int location) { locations.push_back(location); });
+    }
+    return locations;
+}
+
+uint32_t MultiDnaDb::countLocations(string_view sequence) const {
+    uint64_t index = probe(key_of(sequence));
+    return m_ctrl[index] == CTRL_FULL ? m_postings[index].size() : 0;
+}
+
+uint64_t MultiDnaDb::postingBytes() const {
+    uint64_t total = 0;
+    for (uint64_t i = 0; i < m_cap; i++) {
+        if (m_ctrl[i] == CTRL_FULL && m_postings[i].bytes() > POSTINGINLINE) {
+            total += m_postings[i].bytes();
+        }
+    }
+    return total;
+}
+
+void MultiDnaDb::rehash() {
+    //one pass into a table 4x the live sequences, dropping deleted slots
+    //and the arena words of removed keys; the cached hashes re-index the
+    //keys and the posting lists move over without being copied
+    PackedSeq* keys = m_keys;
+    PostingList* postings = m_postings;
+    int8_t* ctrl = m_ctrl;
+    uint64_t* hashes = m_hashes;
+    uint64_t cap = m_cap;
+    SeqArena arena;
+    arena.absorb(m_arena);
+    allocate(max<uint64_t>(4 * size(), MINPRIME));
+    for (uint64_t j = 0; j < cap; j++) {
+        if (ctrl[j] != CTRL_FULL) {
+            continue;
+        }
+        uint64_t index = probe(KeyRef{&keys[j], string_view(), hashes[j]});
+        m_keys[index].assign(keys[j], m_arena);
+        m_postings[index] = std::move(postings[j]);
+        m_hashes[index] = hashes[j];
+        m_ctrl[index] = CTRL_FULL;
+        m_size++;
+    }
+    delete[] keys;
+    delete[] postings;
+    delete[] ctrl;
+    delete[] hashes;
+}
@@ -0,0 +1,135 @@
+#ifndef MULTIDNADB_H
+#define MULTIDNADB_H
+#include "dnadb.h"
+#include <vector>
+
+const int POSTINGINLINE = 8;    // posting bytes kept inside the list itself
+
+// The sorted location IDs of one sequence, as varint deltas (the first
+// from MINLOCID). Locations span less than 2^14, so each takes one or two
+// bytes, and short lists need no allocation at all.
+class PostingList{
+public:
+    friend class Tester;
+    PostingList();
+    ~PostingList();
+    PostingList(const PostingList&) = delete;
+    PostingList& operator=(const PostingList&) = delete;
+    PostingList(PostingList&& rhs) noexcept;
+    PostingList& operator=(PostingList&& rhs) noexcept;
+    uint32_t size() const { return m_count; }
+    bool empty() const { return m_count == 0; }
+    // bytes held by the encoded deltas
+    uint32_t bytes() const { return m_used; }
+    bool contains(int location) const;
+    // false if location is already listed
+    bool insert(int location);
+    // false if location is not listed
+    bool remove(int location);
+    // calls visit(location) in ascending order
+    template <class Visit>
+    void forEach(Visit visit) const;
+
+private:
+    union {
+        uint8_t     m_inline[POSTINGINLINE];
+        uint8_t*    m_bytes;    // when m_capacity > POSTINGINLINE
+    };
+    uint32_t        m_count;    // locations
+    uint16_t        m_used;     // bytes in use
+    uint16_t        m_capacity; // bytes available
+
+    const uint8_t* data() const { return m_capacity > POSTINGINLINE ? m_bytes : m_inline; }
+    uint8_t* data() { return m_capacity > POSTINGINLINE ? m_bytes : m_inline; }
+    // Finds the first location >= location: its delta starts at pos and
+    // takes len bytes, prev is the location before it (MINLOCID for the
+    // first). Returns false, with pos at the end, if there is none.
+    bool seek(int location, uint32_t& pos, int& prev, int& value, uint32_t& len) const;
+    // replaces bytes [pos, pos + len) with the n bytes of with
+    void splice(uint32_t pos, uint32_t len, const uint8_t* with, uint32_t n);
+    void release();
+};
+
+// A DnaDb variant for sequences seen at many locations: every distinct
+// sequence has one slot, holding a PostingList of its locations, instead
+// of one slot per (sequence, location) pair on the same probe sequence.
+// getLocations() returns every location of a sequence after one probe.
+//
+// Slots use PRIME sizing with quadratic probing at most half full, with
+// cached hashes and arena-held keys as in DnaDb. Growth rehashes the whole
+// table at once: a slot is only added per new sequence, so repetitive
+// input rarely gets there.
+class MultiDnaDb{
+public:
+    friend class Tester;
+    // a null hash selects packed keys, as in DnaDb
+    MultiDnaDb(uint64_t size, hash_fn hash);
+    ~MultiDnaDb();
+    MultiDnaDb(const MultiDnaDb&) = delete;
+    MultiDnaDb& operator=(const MultiDnaDb&) = delete;
+    // adds dna's location to its sequence, false if it is a bad location
+    // or already listed
+    bool insert(const DNA& dna);
+    bool emplace(string_view sequence, int location);
+    // drops one location, the sequence goes once it has none left
+    bool remove(const DNA& dna);
+    bool contains(string_view sequence, int location) const;
+    // every location of sequence in ascending order, empty when absent
+    vector<int> getLocations(string_view sequence) const;
+    uint32_t countLocations(string_view sequence) const;
+    // distinct sequences, (sequence, location) pairs and slots
+    uint64_t size() const { return m_size - m_numDeleted; }
+    uint64_t entries() const { return m_entries; }
+    uint64_t capacity() const { return m_cap; }
+    // bytes of all posting lists that live outside their slot
+    uint64_t postingBytes() const;
+
+private:
+    // a sequence being probed for, as DnaDb::KeyRef without the location
+    struct KeyRef {
+        const PackedSeq*    packed;     // nullptr when probing with view
+        string_view         view;
+        uint64_t            hash;
+    };
+
+    hash_fn         m_hash;
+    PackedSeq*      m_keys;
+    PostingList*    m_postings;
+    int8_t*         m_ctrl;         // CTRL_EMPTY, CTRL_DELETED or CTRL_FULL
+    uint64_t*       m_hashes;       // full hash of every full slot
+    uint64_t        m_cap;
+    uint128_t       m_magic;        // fastmod magic of m_cap
+    uint64_t        m_size;         // full and deleted slots
+    uint64_t        m_numDeleted;
+    uint64_t        m_entries;
+    SeqArena        m_arena;        // spilled key words
+
+    KeyRef key_of(const PackedSeq& sequence) const;
+    KeyRef key_of(string_view sequence) const;
+    // index of the slot holding key, or else of the slot an insert would
+    // use (the first deleted or empty one on its probe sequence)
+    uint64_t probe(const KeyRef& key) const;
+    bool add(const KeyRef& key, int location);
+    void rehash();
+    void allocate(uint64_t size);
+};
+
+template <class Visit>
+void PostingList::forEach(Visit visit) const {
+    const uint8_t* bytes = data();
+    int location = MINLOCID;
+    for (uint32_t pos = 0; pos < m_used; ) {
+        uint32_t delta = 0;
+        for (int shift = 0; ; shift += 7) {
+            uint8_t byte = bytes[pos++];
+            delta |= uint32_t(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                break;
+            }
+        }
+        location += delta;
+        visit(location);
+    }
+}
+
+#endif
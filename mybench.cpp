@@ -0,0 +1,563 @@
+#include "dnadb.h"
+#include "concurrentdnadb.h"
+#include "multidnadb.h"
+#include "hashtable.h"
+#include <chrono>
+#include <vector>
+#include <thread>
+#include <cstdlib>
+#include <algorithm>
+#include <fstream>
+#include <unistd.h>
+// Growth benchmark: inserts keys in chunks and, at every checkpoint, reports
+// the cost of the last chunk of inserts and of a sample of lookups. Flat
+// numbers across checkpoints mean the table keeps growing with the data.
+//
+// Thread benchmark: fills a ConcurrentDnaDb from all threads, then runs a
+// fixed number of lookups per thread, doubling the thread count each row.
+// Lookup throughput should grow close to linearly with the threads.
+//
+// Bulk benchmark: loads the same keys once through repeated inserts and
+// then through bulkLoad with 1, 2, 4... threads.
+//
+// Hash benchmark: hashes every k-mer of a synthetic genome with hashCode and
+// each built-in hash, and reports the hashing cost, the hash collisions
+// among distinct k-mers and the probe lengths of a PRIME table half full
+// of them. The genome is AT rich with copied segments and short tandem
+// repeats, the low-entropy input that makes weak hashes cluster.
+//
+// Repeat benchmark: every sequence is seen at many locations. Loads the
+// pairs into a DnaDb (a slot per pair) and a MultiDnaDb (a slot per
+// sequence) and times inserts and (sequence, location) lookups in both.
+//
+// Generic benchmark: integer keys through the HashTable container with
+// each probing policy and growth, the hash and probing inlined.
+//
+// Shrink benchmark: a table spikes to the given entries and collapses to
+// a percentage of them (25 keeps the tombstones under the .8 that forces a
+// rehash), with shrinking off, with the default min load and with a
+// shrinkToFit() after the removes. Reports capacity and resident memory at
+// the peak and after the collapse, and the cost of the removes.
+//
+// Page benchmark: fills a table whose slot arrays come from a SlotAllocator
+// with each page size and NUMA placement (BIND once per node) and times
+// random lookups. Large tables miss the TLB on almost every probe with
+// small pages, huge pages should cut that. Fallbacks count huge page
+// mappings the kernel could not provide.
+//
+// usage: mybench [max entries] [packed|string] [prime|pow2|swiss|robin]
+//        mybench threads [max threads] [entries]
+//        mybench bulk [max threads] [entries]
+//        mybench hashes [k-mers] [k]
+//        mybench repeats [sequences] [locations per sequence]
+//        mybench generic [entries]
+//        mybench shrink [entries] [percent kept]
+//        mybench pages [entries] [lookups]
+using Clock = std::chrono::steady_clock;
+
+class KeyGen {
+public:
+    // splitmix64, cheap enough that key generation does not dominate
+    KeyGen(uint64_t seed) : m_state(seed) {}
+    uint64_t next() {
+        uint64_t z = (m_state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+    // the i-th key of the stream, so lookups can regenerate inserted keys
+    static DNA key(uint64_t i, int length) {
+        KeyGen gen(i);
+        string sequence(length, 'A');
+        uint64_t bits = gen.next();
+        for (int j = 0; j < length; j++) {
+            if (j % 32 == 0 && j > 0) bits = gen.next();
+            sequence[j] = ALPHA[(bits >> (2 * (j % 32))) & 3];
+        }
+        return DNA(sequence, MINLOCID + int(gen.next() % (MAXLOCID - MINLOCID + 1)));
+    }
+private:
+    uint64_t m_state;
+};
+
+double nsPerOp(Clock::time_point start, Clock::time_point stop, uint64_t ops) {
+    return std::chrono::duration<double, std::nano>(stop - start).count() / double(ops);
+}
+
+// runs body(t) on threads threads and returns the wall time
+template <class Body>
+Clock::duration runThreads(unsigned threads, Body body) {
+    vector<std::thread> workers;
+    Clock::time_point start = Clock::now();
+    for (unsigned t = 0; t < threads; t++) {
+        workers.emplace_back(body, t);
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    return Clock::now() - start;
+}
+
+double mopsPerSec(Clock::duration time, uint64_t ops) {
+    return double(ops) / std::chrono::duration<double, std::micro>(time).count();
+}
+
+int threadBench(unsigned maxThreads, uint64_t entries) {
+    const int keyLength = 20;
+    const uint64_t lookupsPerThread = 1000000;
+    cout << "threads,shards,insert_mops,lookup_mops" << endl;
+    vector<DNA> keys;
+    keys.reserve(entries);
+    for (uint64_t i = 0; i < entries; i++) {
+        keys.push_back(KeyGen::key(i, keyLength));
+    }
+    for (unsigned threads = 1; threads <= maxThreads; threads *= 2) {
+        ConcurrentDnaDb dnadb(MINPRIME, nullptr, TABLE_MODE::SWISS);
+        // thread t inserts every threads-th key
+        Clock::duration insertTime = runThreads(threads, [&](unsigned t) {
+            for (uint64_t i = t; i < entries; i += threads) {
+                dnadb.insert(keys[i]);
+            }
+        });
+        vector<vector<pair<string, int>>> queries(threads);
+        for (unsigned t = 0; t < threads; t++) {
+            KeyGen sampler(t + 1);
+            for (uint64_t i = 0; i < 4096; i++) {
+                const DNA& D = keys[sampler.next() % entries];
+                queries[t].emplace_back(D.getSequence(), D.getLocId());
+            }
+        }
+        std::atomic<uint64_t> missed(0);
+        Clock::duration lookupTime = runThreads(threads, [&](unsigned t) {
+            uint64_t found = 0;
+            for (uint64_t i = 0; i < lookupsPerThread; i++) {
+                const auto& Q = queries[t][i & 4095];
+                found += dnadb.contains(Q.first, Q.second);
+            }
+            missed += lookupsPerThread - found;
+        });
+        if (missed != 0) {
+            cout << "lookup missed " << missed << " keys" << endl;
+            return 1;
+        }
+        cout << threads << "," << dnadb.shards() << "," << mopsPerSec(insertTime, entries) << ","
+             << mopsPerSec(lookupTime, lookupsPerThread * threads) << endl;
+    }
+    return 0;
+}
+
+int bulkBench(unsigned maxThreads, uint64_t entries) {
+    const int keyLength = 20;
+    vector<DNA> keys;
+    keys.reserve(entries);
+    for (uint64_t i = 0; i < entries; i++) {
+        keys.push_back(KeyGen::key(i, keyLength));
+    }
+    cout << "method,threads,load_ms" << endl;
+    {
+        DnaDb dnadb(MINPRIME, nullptr, TABLE_MODE::SWISS);
+        Clock::time_point start = Clock::now();
+        for (const auto& D : keys) {
+            dnadb.insert(D);
+        }
+        cout << "insert,1," << nsPerOp(start, Clock::now(), 1000000) << endl;
+    }
+    for (unsigned threads = 1; threads <= maxThreads; threads *= 2) {
+        Clock::time_point start = Clock::now();
+        DnaDb dnadb(keys.data(), keys.size(), nullptr, TABLE_MODE::SWISS, threads);
+        cout << "bulk," << threads << "," << nsPerOp(start, Clock::now(), 1000000) << endl;
+    }
+    return 0;
+}
+
+// AT-rich random sequence with mutated copies of earlier segments and
+// dinucleotide repeats mixed in
+string syntheticGenome(uint64_t length) {
+    KeyGen gen(2024);
+    string genome;
+    genome.reserve(length);
+    const char* biased = "AAATTTCCGG";
+    while (genome.length() < length) {
+        uint64_t r = gen.next();
+        if (r % 16 == 0 && genome.length() > 1000) {
+            // a copy of an earlier 300 bases with about 1% mutations
+            uint64_t from = gen.next() % (genome.length() - 300);
+            for (uint64_t i = from; i < from + 300; i++) {
+                genome += gen.next() % 100 == 0 ? ALPHA[gen.next() % MAX] : genome[i];
+            }
+        }
+        else if (r % 16 == 1) {
+            string unit = {ALPHA[gen.next() % MAX], ALPHA[gen.next() % MAX]};
+            for (int i = 0; i < 20; i++) {
+                genome += unit;
+            }
+        }
+        else {
+            for (int i = 0; i < 100; i++) {
+                genome += biased[gen.next() % 10];
+            }
+        }
+    }
+    genome.resize(length);
+    return genome;
+}
+
+int hashBench(uint64_t kmers, uint32_t k) {
+    string genome = syntheticGenome(kmers + k - 1);
+    vector<string_view> keys;
+    keys.reserve(kmers);
+    for (uint64_t i = 0; i < kmers; i++) {
+        keys.push_back(string_view(genome).substr(i, k));
+    }
+    // the collision and probe counts are over distinct k-mers
+    vector<string_view> distinct = keys;
+    sort(distinct.begin(), distinct.end());
+    distinct.erase(unique(distinct.begin(), distinct.end()), distinct.end());
+    uint64_t cap = PRIMETABLE[prime_index(2 * distinct.size())].prime;
+
+    struct Candidate { const char* name; HASH_KIND kind; bool custom; };
+    const Candidate candidates[] = {
+        {"hashCode", HASH_KIND::PACKED, true},
+        {"packed", HASH_KIND::PACKED, false},
+        {"wyhash", HASH_KIND::WYHASH, false},
+        {"rolling", HASH_KIND::ROLLING, false},
+    };
+    cout << "hash,kmers,distinct,ns_per_key,collisions,avg_probes,max_probes" << endl;
+    for (const Candidate& C : candidates) {
+        auto hash = [&C](string_view key) {
+            return C.custom ? uint64_t(hashCode(key)) : PackedSeq::hash(key, C.kind, 1);
+        };
+        uint64_t checksum = 0;
+        Clock::time_point start = Clock::now();
+        for (string_view key : keys) {
+            checksum += hash(key);
+        }
+        double hashNs = nsPerOp(start, Clock::now(), kmers);
+
+        vector<uint64_t> hashes;
+        hashes.reserve(distinct.size());
+        for (string_view key : distinct) {
+            hashes.push_back(hash(key));
+        }
+        // inserts into a simulated PRIME table, probing as DnaDb does
+        vector<bool> used(cap);
+        uint64_t totalProbes = 0, maxProbes = 0;
+        for (uint64_t h : hashes) {
+            uint64_t index = h % cap, step = 1, probes = 1;
+            while (used[index]) {
+                index += step;
+                if (index >= cap) index -= cap;
+                step += 2;
+                if (step >= cap) step -= cap;
+                probes++;
+            }
+            used[index] = true;
+            totalProbes += probes;
+            maxProbes = max(maxProbes, probes);
+        }
+        sort(hashes.begin(), hashes.end());
+        uint64_t collisions = hashes.end() - unique(hashes.begin(), hashes.end());
+        cout << C.name << "," << kmers << "," << distinct.size() << "," << hashNs << ","
+             << collisions << "," << double(totalProbes) / double(distinct.size()) << ","
+             << maxProbes << (checksum == 42 ? " " : "") << endl;
+    }
+    return 0;
+}
+
+int repeatBench(uint64_t sequences, uint64_t copies) {
+    const int keyLength = 20;
+    const uint64_t samples = 100000;
+    vector<DNA> pairs;
+    for (uint64_t i = 0; i < sequences; i++) {
+        string sequence = KeyGen::key(i, keyLength).getSequence();
+        for (uint64_t c = 0; c < copies; c++) {
+            pairs.push_back(DNA(sequence, MINLOCID + int((i + c * 7919) % (MAXLOCID - MINLOCID + 1))));
+        }
+    }
+    vector<pair<string, int>> queries;
+    KeyGen sampler(7);
+    for (uint64_t i = 0; i < samples; i++) {
+        const DNA& D = pairs[sampler.next() % pairs.size()];
+        queries.emplace_back(D.getSequence(), D.getLocId());
+    }
+    cout << "table,pairs,capacity,insert_ns,lookup_ns" << endl;
+    {
+        DnaDb dnadb(MINPRIME, nullptr);
+        Clock::time_point start = Clock::now();
+        for (const DNA& D : pairs) {
+            dnadb.insert(D);
+        }
+        double insertNs = nsPerOp(start, Clock::now(), pairs.size());
+        uint64_t found = 0;
+        start = Clock::now();
+        for (const auto& Q : queries) {
+            found += dnadb.find(Q.first, Q.second) != nullptr;
+        }
+        double lookupNs = nsPerOp(start, Clock::now(), samples);
+        if (found != samples) {
+            cout << "lookup missed " << samples - found << " keys" << endl;
+            return 1;
+        }
+        cout << "DnaDb," << pairs.size() << "," << dnadb.capacity() << "," << insertNs << ","
+             << lookupNs << endl;
+    }
+    {
+        MultiDnaDb dnadb(MINPRIME, nullptr);
+        Clock::time_point start = Clock::now();
+        for (const DNA& D : pairs) {
+            dnadb.insert(D);
+        }
+        double insertNs = nsPerOp(start, Clock::now(), pairs.size());
+        uint64_t found = 0;
+        start = Clock::now();
+        for (const auto& Q : queries) {
+            found += dnadb.contains(Q.first, Q.second);
+        }
+        double lookupNs = nsPerOp(start, Clock::now(), samples);
+        if (found != samples) {
+            cout << "lookup missed " << samples - found << " keys" << endl;
+            return 1;
+        }
+        cout << "MultiDnaDb," << dnadb.entries() << "," << dnadb.capacity() << "," << insertNs << ","
+             << lookupNs << endl;
+    }
+    return 0;
+}
+
+struct U64Hash {
+    uint64_t operator()(uint64_t key) const { return key; }
+};
+
+// inserts keys[i] -> i, then times lookups of samples of them
+template <class Table>
+int integerBench(const char* name, const vector<uint64_t>& keys, const vector<uint64_t>& queries) {
+    Table table(0);
+    Clock::time_point start = Clock::now();
+    for (uint64_t i = 0; i < keys.size(); i++) {
+        table.insert(keys[i], i);
+    }
+    double insertNs = nsPerOp(start, Clock::now(), keys.size());
+    uint64_t found = 0;
+    start = Clock::now();
+    for (uint64_t key : queries) {
+        found += table.find(key) != nullptr;
+    }
+    double lookupNs = nsPerOp(start, Clock::now(), queries.size());
+    if (found != queries.size()) {
+        cout << "lookup missed " << queries.size() - found << " keys" << endl;
+        return 1;
+    }
+    cout << name << "," << table.size() << "," << table.capacity() << "," << insertNs << ","
+         << lookupNs << endl;
+    return 0;
+}
+
+int genericBench(uint64_t entries) {
+    const uint64_t samples = 1000000;
+    KeyGen sampler(42);
+    cout << "table,entries,capacity,insert_ns,lookup_ns" << endl;
+    vector<uint64_t> keys(entries), lookups(samples);
+    KeyGen gen(7);
+    for (uint64_t& key : keys) {
+        key = gen.next();
+    }
+    for (uint64_t& key : lookups) {
+        key = keys[sampler.next() % entries];
+    }
+    return integerBench<HashTable<uint64_t, uint64_t, U64Hash, LinearProbe, PowerOfTwoGrowth<>>>(
+               "linear 50%", keys, lookups) |
+           integerBench<HashTable<uint64_t, uint64_t, U64Hash, QuadraticProbe, PowerOfTwoGrowth<>>>(
+               "quadratic 50%", keys, lookups) |
+           integerBench<HashTable<uint64_t, uint64_t, U64Hash, QuadraticProbe, PrimeGrowth>>(
+               "quadratic prime", keys, lookups) |
+           integerBench<HashTable<uint64_t, uint64_t, U64Hash, RobinHoodProbe, PowerOfTwoGrowth<90>>>(
+               "robin hood 90%", keys, lookups);
+}
+
+// resident set size from /proc, 0 where there is none
+double residentMb() {
+    ifstream statm("/proc/self/statm");
+    uint64_t pages = 0, resident = 0;
+    statm >> pages >> resident;
+    return double(resident) * double(sysconf(_SC_PAGESIZE)) / (1 << 20);
+}
+
+int shrinkBench(uint64_t entries, uint64_t percentKept) {
+    const int keyLength = 20;
+    const char* configs[] = {"off", "min load", "shrinkToFit"};
+    cout << "config,peak_capacity,capacity,peak_rss_mb,rss_mb,remove_ns" << endl;
+    for (int c = 0; c < 3; c++) {
+        DnaDb dnadb(MINPRIME, nullptr);
+        if (c != 1) {
+            dnadb.setMinLoad(0);
+        }
+        for (uint64_t i = 0; i < entries; i++) {
+            dnadb.insert(KeyGen::key(i, keyLength));
+        }
+        dnadb.finishRehash();
+        uint64_t peakCap = dnadb.capacity();
+        double peakRss = residentMb();
+        // keys are built up front so only the removes are timed
+        uint64_t kept = entries * percentKept / 100;
+        vector<DNA> victims;
+        for (uint64_t i = kept; i < entries; i++) {
+            victims.push_back(KeyGen::key(i, keyLength));
+        }
+        Clock::time_point start = Clock::now();
+        for (const DNA& D : victims) {
+            dnadb.remove(D);
+        }
+        if (c == 2) {
+            dnadb.shrinkToFit();
+        }
+        dnadb.finishRehash();
+        double removeNs = nsPerOp(start, Clock::now(), victims.size());
+        victims = vector<DNA>();
+        cout << configs[c] << "," << peakCap << "," << dnadb.capacity() << "," << peakRss << ","
+             << residentMb() << "," << removeNs << endl;
+    }
+    return 0;
+}
+
+int pageBench(uint64_t entries, uint64_t lookups) {
+    const int keyLength = 20;
+    const char* pageNames[] = {"small", "transparent huge", "explicit huge"};
+    const char* numaNames[] = {"local", "interleave", "bind"};
+    vector<DNA> keys;
+    for (uint64_t i = 0; i < entries; i++) {
+        keys.push_back(KeyGen::key(i, keyLength));
+    }
+    vector<pair<string, int>> queries;
+    KeyGen sampler(11);
+    for (uint64_t i = 0; i < lookups; i++) {
+        const DNA& D = keys[sampler.next() % entries];
+        queries.emplace_back(D.getSequence(), D.getLocId());
+    }
+    cout << "pages,numa,node,capacity,fallbacks,insert_ns,lookup_ns,lookup_mops" << endl;
+    for (PAGE_MODE pages : {PAGE_MODE::SMALL, PAGE_MODE::TRANSPARENT_HUGE, PAGE_MODE::EXPLICIT_HUGE}) {
+        for (NUMA_MODE numa : {NUMA_MODE::LOCAL, NUMA_MODE::INTERLEAVE, NUMA_MODE::BIND}) {
+            int nodes = numa == NUMA_MODE::BIND ? SlotAllocator::numaNodes() : 1;
+            for (int node = 0; node < nodes; node++) {
+                SlotAllocator allocator(pages, numa, node);
+                DnaDb dnadb(MINPRIME, nullptr);
+                dnadb.setSlotAllocator(&allocator);
+                dnadb.reserve(entries);
+                Clock::time_point start = Clock::now();
+                for (const DNA& D : keys) {
+                    dnadb.insert(D);
+                }
+                double insertNs = nsPerOp(start, Clock::now(), entries);
+                uint64_t found = 0;
+                start = Clock::now();
+                for (const auto& Q : queries) {
+                    found += dnadb.find(Q.first, Q.second) != nullptr;
+                }
+                Clock::time_point stop = Clock::now();
+                if (found != lookups) {
+                    cout << "lookup missed " << lookups - found << " keys" << endl;
+                    return 1;
+                }
+                cout << pageNames[int(pages)] << "," << numaNames[int(numa)] << ","
+                     << (numa == NUMA_MODE::BIND ? node : -1) << "," << dnadb.capacity() << ","
+                     << allocator.fallbacks() << "," << insertNs << ","
+                     << nsPerOp(start, stop, lookups) << "," << mopsPerSec(stop - start, lookups)
+                     << endl;
+            }
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1 && string(argv[1]) == "pages") {
+        return pageBench(argc > 2 ? strtoull(argv[2], nullptr, 10) : 4000000,
+                         argc > 3 ? strtoull(argv[3], nullptr, 10) : 2000000);
+    }
+    if (argc > 1 && string(argv[1]) == "shrink") {
+        return shrinkBench(argc > 2 ? strtoull(argv[2], nullptr, 10) : 2000000,
+                           argc > 3 ? strtoull(argv[3], nullptr, 10) : 25);
+    }
+    if (argc > 1 && string(argv[1]) == "generic") {
+        return genericBench(argc > 2 ? strtoull(argv[2], nullptr, 10) : 1000000);
+    }
+    if (argc > 1 && string(argv[1]) == "repeats") {
+        return repeatBench(argc > 2 ? strtoull(argv[2], nullptr, 10) : 2000,
+                           argc > 3 ? strtoull(argv[3], nullptr, 10) : 500);
+    }
+    if (argc > 1 && string(argv[1]) == "hashes") {
+        return hashBench(argc > 2 ? strtoull(argv[2], nullptr, 10) : 1000000,
+                         argc > 3 ? uint32_t(strtoul(argv[3], nullptr, 10)) : 31);
+    }
+    if (argc > 1 && string(argv[1]) == "bulk") {
+        unsigned maxThreads = argc > 2 ? unsigned(strtoul(argv[2], nullptr, 10))
+                                       : max(1u, std::thread::hardware_concurrency());
+        return bulkBench(maxThreads, argc > 3 ? strtoull(argv[3], nullptr, 10) : 1000000);
+    }
+    if (argc > 1 && string(argv[1]) == "threads") {
+        unsigned maxThreads = argc > 2 ? unsigned(strtoul(argv[2], nullptr, 10))
+                                       : max(1u, std::thread::hardware_concurrency());
+        return threadBench(maxThreads, argc > 3 ? strtoull(argv[3], nullptr, 10) : 1000000);
+    }
+    uint64_t maxEntries = argc > 1 ? strtoull(argv[1], nullptr, 10) : 10000000;
+    bool packed = !(argc > 2 && string(argv[2]) == "string");
+    string modeName = argc > 3 ? argv[3] : "prime";
+    TABLE_MODE mode = modeName == "pow2" ? TABLE_MODE::POWER_OF_TWO
+                    : modeName == "swiss" ? TABLE_MODE::SWISS
+                    : modeName == "robin" ? TABLE_MODE::ROBIN_HOOD : TABLE_MODE::PRIME;
+    const int keyLength = 20;
+    const uint64_t samples = 100000;
+    DnaDb dnadb(MINPRIME, packed ? nullptr : hashCode, mode);
+    KeyGen sampler(42);
+    cout << "entries,capacity,insert_ns,lookup_ns,batch_ns" << endl;
+    uint64_t inserted = 0;
+    for (uint64_t checkpoint = 1000; inserted < maxEntries; checkpoint *= 2) {
+        if (checkpoint > maxEntries) checkpoint = maxEntries;
+        // pre-generate the chunk so only the table is timed
+        vector<DNA> chunk;
+        chunk.reserve(checkpoint - inserted);
+        for (uint64_t i = inserted; i < checkpoint; i++) {
+            chunk.push_back(KeyGen::key(i, keyLength));
+        }
+        Clock::time_point start = Clock::now();
+        for (const auto& D : chunk) {
+            dnadb.insert(D);
+        }
+        Clock::time_point stop = Clock::now();
+        double insertNs = nsPerOp(start, stop, chunk.size());
+        inserted = checkpoint;
+
+        // queries are unpacked up front, as a caller would hold them
+        vector<pair<string, int>> queries;
+        queries.reserve(samples);
+        for (uint64_t i = 0; i < samples; i++) {
+            DNA D = KeyGen::key(sampler.next() % inserted, keyLength);
+            queries.emplace_back(D.getSequence(), D.getLocId());
+        }
+        uint64_t found = 0;
+        start = Clock::now();
+        for (const auto& Q : queries) {
+            found += dnadb.find(Q.first, Q.second) != nullptr;
+        }
+        stop = Clock::now();
+        double lookupNs = nsPerOp(start, stop, samples);
+
+        // the same queries through findMany
+        vector<string_view> views;
+        vector<int> locations;
+        for (const auto& Q : queries) {
+            views.push_back(Q.first);
+            locations.push_back(Q.second);
+        }
+        vector<const DNA*> results(samples);
+        start = Clock::now();
+        uint64_t batchFound = dnadb.findMany(views.data(), locations.data(), samples, results.data());
+        stop = Clock::now();
+        if (found != samples || batchFound != samples) {
+            cout << "lookup missed " << samples - min(found, batchFound) << " keys" << endl;
+            return 1;
+        }
+        cout << inserted << "," << dnadb.capacity() << "," << insertNs << ","
+             << lookupNs << "," << nsPerOp(start, stop, samples) << endl;
+    }
+    return 0;
+}
@@ -1,80 +1,68 @@
 #include "dnadb.h"
+#include "concurrentdnadb.h"
+#include "lockfreednadb.h"
+#include "snapshot.h"
+#include "multidnadb.h"
+#include "dnarandom.h"
+#include "hashtable.h"
+#include <fstream>
 #include <random>
 #include <vector>
 #include <set>
+#include <map>
 #include <algorithm>
-enum RANDOM { UNIFORMINT, UNIFORMREAL, NORMAL };
-class Random {
-public:
-    Random(int min, int max, RANDOM type = UNIFORMINT, int mean = 50, int stdev = 20) : m_min(min), m_max(max), m_type(type)
-    {
-        if (type == NORMAL) {
-            //the case of NORMAL to generate integer numbers with normal distribution
-            m_generator = std::mt19937(m_device());
-            //the data set will have the mean of 50 (default) and standard deviation of 20 (default)
-            //the mean and standard deviation can change by passing new values to constructor
-            m_normdist = std::normal_distribution<>(mean, stdev);
-        }
-        else if (type == UNIFORMINT) {
-            //the case of UNIFORMINT to generate integer numbers
-            // Using a fixed seed value generates always the same sequence
-            // of pseudorandom numbers, e.g. reproducing scientific experiments
-            // here it helps us with testing since the same sequence repeats
-            m_generator = std::mt19937(10);// 10 is the fixed seed value
-            m_unidist = std::uniform_int_distribution<>(min, max);
-        }
-        else { //the case of UNIFORMREAL to generate real numbers
-            m_generator = std::mt19937(10);// 10 is the fixed seed value
-            m_uniReal = std::uniform_real_distribution<double>((double)min, (double)max);
-        }
-    }
-    void setSeed(int seedNum) {
-        // we have set a default value for seed in constructor
-        // we can change the seed by calling this function after constructor call
-        // this gives us more randomness
-        m_generator = std::mt19937(seedNum);
-    }
-
-    int getRandNum() {
-        // this function returns integer numbers
-        // the object must have been initialized to generate integers
-        int result = 0;
-        if (m_type == NORMAL) {
-            //returns a random number in a set with normal distribution
-            //we limit random numbers by the min and max values
-            result = m_min - 1;
-            while (result < m_min || result > m_max)
-                result = m_normdist(m_generator);
-        }
-        else if (m_type == UNIFORMINT) {
-            //this will generate a random number between min and max values
-            result = m_unidist(m_generator);
-        }
-        return result;
-    }
-
-    double getRealRandNum() {
-        // this function returns real numbers
-        // the object must have been initialized to generate real numbers
-        double result = m_uniReal(m_generator);
-        // a trick to return numbers only with two deciaml points
-        // for example if result is 15.0378, function returns 15.03
-        // to round up we can use ceil function instead of floor
-        result = std::floor(result * 100.0) / 100.0;
-        return result;
-    }
-
-private:
-    int m_min;
-    int m_max;
-    RANDOM m_type;
-    std::random_device m_device;
-    std::mt19937 m_generator;
-    std::normal_distribution<> m_normdist;//normal distribution
-    std::uniform_int_distribution<> m_unidist;//integer uniform distribution
-    std::uniform_real_distribution<double> m_uniReal;//real uniform distribution
+#include <cstdlib>
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <thread>
+
+// Counts heap allocations so tests can check allocation-free paths. The
+// whole replaceable family (array, sized, aligned, nothrow) goes through
+// malloc/aligned_alloc and free, so every new meets a matching delete.
+// That includes the heap side of SlotAllocator, whose small arrays are
+// counted like any other allocation.
+static std::atomic<unsigned long long> allocations(0);
+static void* counted_alloc(size_t size, size_t alignment) noexcept {
+    allocations++;
+    size = size ? size : 1;
+    if (alignment <= alignof(std::max_align_t)) {
+        return malloc(size);
+    }
+    return aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+}
+static void* checked_alloc(size_t size, size_t alignment) {
+    void* ptr = counted_alloc(size, alignment);
+    if (ptr == nullptr) throw std::bad_alloc();
+    return ptr;
+}
+// out of line, so the compiler never pairs an inlined free() with new
+__attribute__((noinline)) static void release(void* ptr) noexcept { free(ptr); }
+void* operator new(size_t size) { return checked_alloc(size, 0); }
+void* operator new[](size_t size) { return checked_alloc(size, 0); }
+void* operator new(size_t size, std::align_val_t al) { return checked_alloc(size, size_t(al)); }
+void* operator new[](size_t size, std::align_val_t al) { return checked_alloc(size, size_t(al)); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return counted_alloc(size, 0); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return counted_alloc(size, 0); }
+void* operator new(size_t size, std::align_val_t al, const std::nothrow_t&) noexcept {
+    return counted_alloc(size, size_t(al));
+}
+void* operator new[](size_t size, std::align_val_t al, const std::nothrow_t&) noexcept {
+    return counted_alloc(size, size_t(al));
+}
+void operator delete(void* ptr) noexcept { release(ptr); }
+void operator delete[](void* ptr) noexcept { release(ptr); }
+void operator delete(void* ptr, size_t) noexcept { release(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { release(ptr); }
+void operator delete(void* ptr, std::align_val_t) noexcept { release(ptr); }
+void operator delete[](void* ptr, std::align_val_t) noexcept { release(ptr); }
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept { release(ptr); }
+void operator delete[](void* ptr, size_t, std::align_val_t) noexcept { release(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { release(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { release(ptr); }
+void operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept { release(ptr); }
+void operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) noexcept { release(ptr); }
 
-};
 class Tester {
 public:
     bool test_insert();
@@ -82,48 +70,133 @@ public:
     bool test_find_colliding();
     bool test_remove();
     bool test_remove_colliding();
+    bool test_reinsert_past_deleted();
     bool test_rehash_insertion();
     bool test_rehash_removal();
+    bool test_packed_keys();
+    bool test_large_capacity();
+    bool test_power_of_two();
+    bool test_swiss();
+    bool test_sentinel_free();
+    bool test_find_view();
+    bool test_migration_budget();
+    bool test_background_rehash();
+    bool test_concurrent_shards();
+    bool test_concurrent_hash_once();
+    bool test_lock_free();
+    bool test_lock_free_churn();
+    bool test_find_many();
+    bool test_bulk_load();
+    bool test_snapshot();
+    bool test_snapshot_damaged();
+    bool test_arena_storage();
+    bool test_cached_hash();
+    bool test_hash_kinds();
+    bool test_kmers();
+    bool test_multimap();
+    bool test_stats();
+    bool test_generic_table();
+    bool test_robin_hood();
+    bool test_shrink();
+    bool test_slot_allocator();
+    bool test_fingerprints();
 };
 
-unsigned int hashCode(const string str);
-string sequencer(int size, int seedNum);
+// hashCode that counts its calls
+static unsigned long long hashCalls = 0;
+unsigned int countingHash(string_view str) {
+    hashCalls++;
+    return hashCode(str);
+}
+
+// SlotAllocator that keeps count of the bytes it has handed out
+class CountingAllocator : public SlotAllocator {
+public:
+    int64_t outstanding = 0;
+    void* allocate(uint64_t bytes) override {
+        outstanding += int64_t(bytes);
+        return SlotAllocator::allocate(bytes);
+    }
+    void deallocate(void* memory, uint64_t bytes) override {
+        outstanding -= int64_t(bytes);
+        SlotAllocator::deallocate(memory, bytes);
+    }
+};
 
 int main() {
     Tester tester;
-    tester.test_insert();
+    bool passed = true;
+    passed = tester.test_insert() && passed;
     cout << endl;
-    tester.test_find();
+    passed = tester.test_find() && passed;
     cout << endl;
-    tester.test_find_colliding();
+    passed = tester.test_find_colliding() && passed;
     cout << endl;
-    tester.test_remove();
+    passed = tester.test_remove() && passed;
     cout << endl;
-    tester.test_remove_colliding();
+    passed = tester.test_remove_colliding() && passed;
     cout << endl;
-    tester.test_rehash_insertion();
+    passed = tester.test_reinsert_past_deleted() && passed;
     cout << endl;
-    tester.test_rehash_removal();
-    return 0;
-}
-unsigned int hashCode(const string str) {
-    unsigned int val = 0;
-    const unsigned int thirtyThree = 33;  // magic number from textbook
-    for (int i = 0; i < str.length(); i++)
-        val = val * thirtyThree + str[i];
-    return val;
-}
-string sequencer(int size, int seedNum) {
-    //this function returns a random DNA sequence
-    string sequence = "";
-    Random rndObject(0, 3);
-    rndObject.setSeed(seedNum);
-    for (int i = 0; i < size; i++) {
-        sequence = sequence + ALPHA[rndObject.getRandNum()];
-    }
-    return sequence;
+    passed = tester.test_rehash_insertion() && passed;
+    cout << endl;
+    passed = tester.test_rehash_removal() && passed;
+    cout << endl;
+    passed = tester.test_packed_keys() && passed;
+    cout << endl;
+    passed = tester.test_large_capacity() && passed;
+    cout << endl;
+    passed = tester.test_power_of_two() && passed;
+    cout << endl;
+    passed = tester.test_swiss() && passed;
+    cout << endl;
+    passed = tester.test_sentinel_free() && passed;
+    cout << endl;
+    passed = tester.test_find_view() && passed;
+    cout << endl;
+    passed = tester.test_migration_budget() && passed;
+    cout << endl;
+    passed = tester.test_background_rehash() && passed;
+    cout << endl;
+    passed = tester.test_concurrent_shards() && passed;
+    cout << endl;
+    passed = tester.test_concurrent_hash_once() && passed;
+    cout << endl;
+    passed = tester.test_lock_free() && passed;
+    cout << endl;
+    passed = tester.test_lock_free_churn() && passed;
+    cout << endl;
+    passed = tester.test_find_many() && passed;
+    cout << endl;
+    passed = tester.test_bulk_load() && passed;
+    cout << endl;
+    passed = tester.test_snapshot() && passed;
+    cout << endl;
+    passed = tester.test_snapshot_damaged() && passed;
+    cout << endl;
+    passed = tester.test_arena_storage() && passed;
+    cout << endl;
+    passed = tester.test_cached_hash() && passed;
+    cout << endl;
+    passed = tester.test_hash_kinds() && passed;
+    cout << endl;
+    passed = tester.test_kmers() && passed;
+    cout << endl;
+    passed = tester.test_multimap() && passed;
+    cout << endl;
+    passed = tester.test_stats() && passed;
+    cout << endl;
+    passed = tester.test_generic_table() && passed;
+    cout << endl;
+    passed = tester.test_robin_hood() && passed;
+    cout << endl;
+    passed = tester.test_shrink() && passed;
+    cout << endl;
+    passed = tester.test_slot_allocator() && passed;
+    cout << endl;
+    passed = tester.test_fingerprints() && passed;
+    return passed ? 0 : 1;   // nonzero for ctest when a test failed
 }
-
 bool Tester::test_insert() {
     cout << "Testing Insert Function:" << endl;
     set<unsigned int> used_hash_indices;
@@ -290,7 +363,9 @@ bool Tester::test_remove(){
             return false;
         }
     }
-    if (dnadb.m_currentSize != 0){
+    // m_currentSize counts deleted slots, and a removal may have started
+    // a rehash whose old table still holds some of them
+    if (dnadb.m_currentSize != dnadb.m_currNumDeleted || dnadb.m_oldSize != dnadb.m_oldNumDeleted){
         cout << "Operation Failed" << endl;
         return false;
     }
@@ -321,7 +396,9 @@ bool Tester::test_remove_colliding(){
             return false;
         }
     }
-    if (dnadb.m_currentSize != 0){
+    // m_currentSize counts deleted slots, and a removal may have started
+    // a rehash whose old table still holds some of them
+    if (dnadb.m_currentSize != dnadb.m_currNumDeleted || dnadb.m_oldSize != dnadb.m_oldNumDeleted){
         cout << "Operation Failed" << endl;
         return false;
     }
@@ -329,6 +406,67 @@ bool Tester::test_remove_colliding(){
     return true;
 }
 
+bool Tester::test_reinsert_past_deleted() {
+    cout << "Testing Reinsert of a Key Stored Past a Deleted Slot" << endl;
+    for (TABLE_MODE mode : {TABLE_MODE::PRIME, TABLE_MODE::POWER_OF_TWO, TABLE_MODE::SWISS,
+                            TABLE_MODE::ROBIN_HOOD}) {
+        DnaDb dnadb(MINPRIME, hashCode, mode);
+        // the hash ignores the location, so these share one probe sequence
+        vector<DNA> chain;
+        for (int i = 0; i < 8; i++) {
+            chain.push_back(DNA("ACGTA", MINLOCID + i));
+            dnadb.insert(chain.back());
+        }
+        dnadb.remove(chain.front());
+        if (dnadb.insert(chain.back()) || dnadb.m_currentSize - dnadb.m_currNumDeleted != 7) {
+            cout << "The key past the deleted slot was stored twice" << endl;
+            return false;
+        }
+        if (!dnadb.remove(chain.back()) || dnadb.find("ACGTA", chain.back().getLocId()) != nullptr) {
+            cout << "A second copy survived the remove" << endl;
+            return false;
+        }
+        // reusing a deleted slot takes it off the deleted count
+        uint64_t slots = dnadb.m_currentSize;
+        if (!dnadb.insert(chain.front()) || dnadb.m_currentSize - dnadb.m_currNumDeleted != 7 ||
+            (mode != TABLE_MODE::ROBIN_HOOD && dnadb.m_currentSize != slots)) {
+            cout << "Reusing a deleted slot miscounted the table" << endl;
+            return false;
+        }
+        // and the counts follow a random insert/remove model
+        dnadb.setRehashBudget(1);
+        set<int> model;
+        for (int i = 0; i < 7; i++) {
+            model.insert(chain[i].getLocId());
+        }
+        Random RndLocation(MINLOCID, MINLOCID + 199);
+        Random RndOp(0, 1);
+        for (int i = 0; i < 20000; i++) {
+            int location = RndLocation.getRandNum();
+            DNA dna("ACGTA", location);
+            bool present = model.count(location) != 0;
+            bool inserting = RndOp.getRandNum() == 0;
+            bool ok = inserting ? dnadb.insert(dna) == !present : dnadb.remove(dna) == present;
+            if (!ok) {
+                cout << "Operation " << i << " disagrees with the model" << endl;
+                return false;
+            }
+            if (inserting) {
+                model.insert(location);
+            }
+            else {
+                model.erase(location);
+            }
+        }
+        if (dnadb.stats().size != model.size()) {
+            cout << dnadb.stats().size << " entries counted, " << model.size() << " expected" << endl;
+            return false;
+        }
+    }
+    cout << "Test Successful" << endl;
+    return true;
+}
+
 bool Tester::test_rehash_insertion(){
     cout << endl << "testing Rehashing During Insertions" << endl;
     DnaDb dnadb(MINPRIME, hashCode);
@@ -347,14 +485,16 @@ bool Tester::test_rehash_insertion(){
     cout << "Old Table Capacity: " << dnadb.m_oldCap << endl;
     cout << "Inserting " << dataList.size() << " colliding DNA Objects." << endl << endl;
     for (const auto& D : dataList){
+        bool rehashing = dnadb.m_oldTable != nullptr;
         dnadb.insert(D);
-        if (dnadb.rehash_status != DnaDb::REHASH_STATUS::NOT_REHASHING){
-            if (dnadb.rehash_status == DnaDb::REHASH_STATUS::QUARTER){
+        if (dnadb.m_oldTable != nullptr){
+            if (!rehashing){
                 cout << "Rehash Triggered!" << endl;
             }
             else{
                 cout << "Rehash still in Progress!" << endl;
             }
+            cout << "Migration Cursor: " << dnadb.m_migrateCursor << endl;
             cout << "Current Table Size: " << dnadb.m_currentSize << endl;
             cout << "Current Table Capacity: " << dnadb.m_currentCap << endl;
             cout << "Old Table Size: " << dnadb.m_oldSize << endl;
@@ -394,17 +534,19 @@ bool Tester::test_rehash_removal() {
     cout << "Removing all Objects" << endl;
     for (int i = 0, I = dataList.size(); i < I; i++){ //looping through everything
         DNA D = dataList.at(i);
+        bool rehashing = dnadb.m_oldTable != nullptr;
         if (dnadb.remove(D) == false){
             cout << "Operation Failed" << endl;
             return false;
         }
-        if (dnadb.rehash_status != DnaDb::REHASH_STATUS::NOT_REHASHING){
-            if (dnadb.rehash_status == DnaDb::REHASH_STATUS::QUARTER){
+        if (dnadb.m_oldTable != nullptr){
+            if (!rehashing){
                 cout << "Rehash Triggered!" << endl;
             }
             else{
                 cout << "Rehash still in Progress!" << endl;
             }
+            cout << "Migration Cursor: " << dnadb.m_migrateCursor << endl;
             cout << "Current Table Size: " << dnadb.m_currentSize << endl;
             cout << "Current Table Deleted Size: " << dnadb.m_currNumDeleted << endl;
             cout << "Current Table Capacity: " << dnadb.m_currentCap << endl;
@@ -421,4 +563,1594 @@ bool Tester::test_rehash_removal() {
     cout << "Old Table Deleted Size: " << dnadb.m_oldNumDeleted << endl;
     cout << "Old Table Capacity: " << dnadb.m_oldCap << endl << endl;
     return true;
-}
\ No newline at end of file
+}
+
+bool Tester::test_packed_keys() {
+    cout << endl << "Testing Packed Key Mode" << endl;
+    // round trips for inline, spilled and raw (non ACGT) keys
+    vector<string> keys = {"", "ACGT", sequencer(32, 1), sequencer(33, 2),
+                           sequencer(150, 3), "DELETED", "ACGTNACGTN"};
+    for (const auto& K : keys) {
+        PackedSeq packed(K);
+        if (packed.toString() != K || packed.isPacked() != PackedSeq::packable(K)) {
+            cout << "Round Trip Failed for " << K << endl;
+            return false;
+        }
+    }
+    if (PackedSeq(sequencer(33, 2)) == PackedSeq(sequencer(33, 4))) {
+        cout << "Equality Failed" << endl;
+        return false;
+    }
+    cout << "Round Trips Succeeded!" << endl;
+    DnaDb dnadb(MINPRIME, nullptr);
+    vector<DNA> dataList;
+    Random RndLocation(MINLOCID, MAXLOCID);
+    for (int i = 0; i < 99; i++) {
+        // mix of short and long k-mers
+        DNA dataObj = DNA(sequencer(i % 2 ? 5 : 100, i), RndLocation.getRandNum());
+        if (std::find(dataList.cbegin(), dataList.cend(), dataObj) == dataList.cend()) {
+            dataList.push_back(dataObj);
+        }
+    }
+    cout << "Inserting " << dataList.size() << " packed DNA Objects." << endl;
+    for (const auto& D : dataList) {
+        dnadb.insert(D);
+    }
+    for (const auto& D : dataList) {
+        DNA temp = dnadb.getDNA(D.getSequence(), D.getLocId());
+        if (!(temp == D)) {
+            cout << "Test Failed!" << endl;
+            return false;
+        }
+    }
+    cout << "Test Successful" << endl;
+    return true;
+}
+
+bool Tester::test_large_capacity() {
+    cout << endl << "Testing Growth Past the Old 99991 Capacity Ceiling" << endl;
+    DnaDb dnadb(MINPRIME, nullptr);
+    vector<DNA> dataList;
+    Random RndLocation(MINLOCID, MAXLOCID);
+    for (int i = 0; i < 200000; i++) {
+        DNA dataObj = DNA(sequencer(12, i), RndLocation.getRandNum());
+        if (dnadb.insert(dataObj)) {
+            dataList.push_back(dataObj);
+        }
+    }
+    cout << "Inserted " << dataList.size() << " DNA Objects." << endl;
+    cout << "Current Table Capacity: " << dnadb.m_currentCap << endl;
+    if (dnadb.m_currentCap <= 99991 || dnadb.lambda() > .5f) {
+        cout << "Test Failed!" << endl;
+        return false;
+    }
+    for (const auto& D : dataList) {
+        if (!(dnadb.getDNA(D.getSequence(), D.getLocId()) == D)) {
+            cout << "Test Failed!" << endl;
+            return false;
+        }
+    }
+    cout << "Test Successful" << endl;
+    return true;
+}
+
+bool Tester::test_power_of_two() {
+    cout << endl << "Testing Power-of-Two Capacity Mode" << endl;
+    DnaDb dnadb(MINPRIME, hashCode, TABLE_MODE::POWER_OF_TWO);
+    vector<DNA> dataList;
+    Random RndLocation(MINLOCID, MAXLOCID);
+    for (int i = 0; i < 999; i++) {
+        DNA dataObj = DNA(sequencer(5, i), RndLocation.getRandNum());
+        if (std::find(dataList.cbegin(), dataList.cend(), dataObj) == dataList.cend()) {
+            dataList.push_back(dataObj);
+        }
+    }
+    cout << "Inserting " << dataList.size() << " colliding DNA Objects." << endl;
+    for (const auto& D : dataList) {
+        dnadb.insert(D);
+        if ((dnadb.m_currentCap & (dnadb.m_currentCap - 1)) != 0) {
+            cout << "Capacity " << dnadb.m_currentCap << " is not a power of two" << endl;
+            return false;
+        }
+    }
+    cout << "Current Table Capacity: " << dnadb.m_currentCap << endl;
+    for (const auto& D : dataList) {
+        if (!(dnadb.getDNA(D.getSequence(), D.getLocId()) == D)) {
+            cout << "Test Failed!" << endl;
+            return false;
+        }
+    }
+    cout << "Test Successful" << endl;
+    return true;
+}
+
+bool Tester::test_swiss() {
+    cout << endl << "Testing Swiss Table Mode" << endl;
+    DnaDb dnadb(MINPRIME, hashCode, TABLE_MODE::SWISS);
+    vector<DNA> dataList;
+    Random RndLocation(MINLOCID, MAXLOCID);
+    for (int i = 0; i < 999; i++) {
+        DNA dataObj = DNA(sequencer(5, i), RndLocation.getRandNum());
+        if (std::find(dataList.cbegin(), dataList.cend(), dataObj) == dataList.cend()) {
+            dataList.push_back(dataObj);
+        }
+    }
+    cout << "Inserting " << dataList.size() << " colliding DNA Objects." << endl;
+    float maxLoad = 0;
+    for (const auto& D : dataList) {
+        dnadb.insert(D);
+        maxLoad = max(maxLoad, dnadb.lambda());
+    }
+    cout << "Highest Load Factor: " << maxLoad << endl;
+    if (maxLoad <= .5f || maxLoad > SWISSMAXLOAD) {
+        cout << "Test Failed!" << endl;
+        return false;
+    }
+    cout << "Removing every other Object" << endl;
+    for (unsigned int i = 0; i < dataList.size(); i += 2) {
+        if (!dnadb.remove(dataList[i])) {
+            cout << "Operation Failed" << endl;
+            return false;
+        }
+    }
+    for (unsigned int i = 0; i < dataList.size(); i++) {
+        DNA temp = dnadb.getDNA(dataList[i].getSequence(), dataList[i].getLocId());
+        if ((i % 2 == 0) != (temp == EMPTY)) {
+            cout << "Test Failed!" << endl;
+            return false;
+        }
+    }
+    cout << "Test Successful" << endl;
+    return true;
+}
+
+bool Tester::test_sentinel_free() {
+    cout << endl << "Testing Allocation Free Misses" << endl;
+    Random RndLocation(MINLOCID, MAXLOCID);
+    vector<string> misses;
+    for (int i = 0; i < 100; i++) {
+        misses.push_back(sequencer(5, 1000 + i));
+    }
+    for (hash_fn hash : {hashCode, (hash_fn)nullptr}) {
+        for (TABLE_MODE mode : {TABLE_MODE::PRIME, TABLE_MODE::SWISS,
+                                TABLE_MODE::ROBIN_HOOD}) {
+            DnaDb dnadb(MINPRIME, hash, mode);
+            for (int i = 0; i < 49; i++) {
+                dnadb.insert(DNA(sequencer(5, i), RndLocation.getRandNum()));
+            }
+            unsigned long long before = allocations;
+            for (const auto& S : misses) {
+                // location 999 is never stored so every lookup misses
+                dnadb.getDNA(S, MINLOCID - 1);
+                dnadb.getDNA(S, MAXLOCID);
+            }
+            if (allocations != before) {
+                cout << "Lookups allocated " << allocations - before << " times" << endl;
+                return false;
+            }
+        }
+    }
+    cout << "Test Successful" << endl;
+    cout << "Testing a real DELETED Sequence across a Rehash" << endl;
+    DnaDb dnadb(MINPRIME, hashCode);
+    DNA deleted("DELETED", MINLOCID);
+    dnadb.insert(deleted);
+    for (int i = 0; i < 99; i++) {
+        dnadb.insert(DNA(sequencer(5, i), RndLocation.getRandNum()));
+    }
+    if (dnadb.m_currentCap == MINPRIME || dnadb.m_oldTable != nullptr ||
+        !(dnadb.getDNA("DELETED", MINLOCID) == deleted)) {
+        cout << "Test Failed!" << endl;
+        return false;
+    }
+    cout << "Test Successful" << endl;
+    return true;
+}
+
+bool Tester::test_find_view() {
+    cout << endl << "Testing string_view Find and Emplace" << endl;
+    Random RndLocation(MINLOCID, MAXLOCID);
+    vector<string> sequences;
+    vector<int> locations;
+    for (int i = 0; i < 99; i++) {
+        sequences.push_back(sequencer(i % 2 ? 5 : 100, i));
+        locations.push_back(RndLocation.getRandNum());
+    }
+    for (hash_fn hash : {hashCode, (hash_fn)nullptr}) {
+        DnaDb dnadb(MINPRIME, hash);
+        for (int i = 0; i < 99; i++) {
+            if (i % 3 == 0) {
+                dnadb.insert(DNA(sequences[i], locations[i]));  // move insert
+            }
+            else if (!dnadb.emplace(sequences[i], locations[i])) {
+                cout << "Emplace Failed!" << endl;
+                return false;
+            }
+        }
+        if (dnadb.emplace(sequences[1], locations[1])) {
+            cout << "Duplicate Emplace Succeeded!" << endl;
+            return false;
+        }
+        unsigned long long before = allocations;
+        for (int i = 0; i < 99; i++) {
+            const DNA* found = dnadb.find(sequences[i], locations[i]);
+            if (found == nullptr || found->getLocId() != locations[i]) {
+                cout << "Find Failed!" << endl;
+                return false;
+            }
+            if (dnadb.find(sequences[i], locations[i] == MAXLOCID ? MINLOCID : MAXLOCID) != nullptr) {
+                cout << "Find Failed!" << endl;
+                return false;
+            }
+        }
+        if (allocations != before) {
+            cout << "Finds allocated " << allocations - before << " times" << endl;
+            return false;
+        }
+    }
+    cout << "Test Successful" << endl;
+    return true;
+}
+
+bool Tester::test_migration_budget() {
+    cout << endl << "Testing Bounded Migration Work per Insert" << endl;
+    for (uint64_t budget : {1, 4, 64}) {
+        DnaDb dnadb(MINPRIME, hashCode);
+        dnadb.setRehashBudget(budget);
+        vector<DNA> dataList;
+        Random RndLocation(MINLOCID, MAXLOCID);
+        uint64_t rehashes = 0;
+        for (int i = 0; i < 999; i++) {
+            DNA dataObj = DNA(sequencer(5, i), RndLocation.getRandNum());
+            bool rehashing = dnadb.m_oldTable != nullptr;
+            uint64_t cursor = dnadb.m_migrateCursor;
+            if (!dnadb.insert(dataObj)) {
+                continue;
+            }
+            dataList.push_back(dataObj);
+            if (dnadb.m_oldTable != nullptr) {
+                // each insert only advances the cursor by one step
+                if (!rehashing) {
+                    rehashes++;
+                    cursor = 0;
+                }
+                if (dnadb.m_migrateStep < budget ||
+                    dnadb.m_migrateCursor - cursor > dnadb.m_migrateStep) {
+                    cout << "Migrated " << dnadb.m_migrateCursor - cursor << " slots in one insert" << endl;
+                    return false;
+                }
+            }
+            if (i % 7 == 0) {
+                for (const auto& D : dataList) {
+                    if (dnadb.find(D.getSequence(), D.getLocId()) == nullptr) {
+                        cout << "Lost an entry during migration" << endl;
+                        return false;
+                    }
+                }
+            }
+        }
+        cout << "Budget " << budget << ": " << rehashes << " rehashes, capacity "
+             << dnadb.m_currentCap << endl;
+    }
+    cout << "Test Successful" << endl;
+    return true;
+}
+bool Tester::test_background_rehash() {
+    cout << endl << "Testing Background Rehash with Concurrent Readers" << endl;
+    for (TABLE_MODE mode : {TABLE_MODE::PRIME, TABLE_MODE::SWISS}) {
+        DnaDb dnadb(MINPRIME, hashCode, mode);
+        dnadb.setBackgroundRehash(true);
+        vector<DNA> dataList;
+        Random RndLocation(MINLOCID, MAXLOCID);
+        for (int i = 0; i < 20000; i++) {
+            DNA dataObj = DNA(sequencer(12, i), RndLocation.getRandNum());
+            if (dnadb.insert(dataObj)) {
+                dataList.push_back(dataObj);
+            }
+        }
+        dnadb.finishRehash();
+        // force one more rehash and read both tables while it runs
+        {
+            std::lock_guard<std::mutex> guard(dnadb.m_lock);
+            dnadb.rehash();
+        }
+        std::atomic<uint64_t> misses(0);
+        vector<std::thread> readers;
+        for (int t = 0; t < 4; t++) {
+            readers.emplace_back([&dnadb, &dataList, &misses, t] {
+                for (size_t i = t; i < dataList.size(); i += 4) {
+                    const DNA& D = dataList[i];
+                    if (dnadb.getDNA(D.getSequence(), D.getLocId()) == EMPTY) {
+                        misses++;
+                    }
+                }
+            });
+        }
+        for (auto& reader : readers) {
+            reader.join();
+        }
+        dnadb.finishRehash();
+        if (misses != 0 || dnadb.m_oldTable != nullptr) {
+            cout << misses << " lookups missed during migration" << endl;
+            return false;
+        }
+        for (const auto& D : dataList) {
+            if (dnadb.find(D.getSequence(), D.getLocId()) == nullptr) {
+                cout << "Lost an entry during migration" << endl;
+                return false;
+            }
+        }
+        cout << dataList.size() << " entries, capacity " << dnadb.m_currentCap << endl;
+    }
+    cout << "Test Successful" << endl;
+    return true;
+}
+
+bool Tester::test_concurrent_shards() {
+    cout << endl << "Testing Sharded Table with Concurrent Writers and Readers" << endl;
+    const int threads = 4;
+    const int perThread = 5000;
+    ConcurrentDnaDb dnadb(MINPRIME, hashCode, TABLE_MODE::PRIME, 8);
+    vector<vector<DNA>> dataLists(threads);
+    for (int t = 0; t < threads; t++) {
+        Random RndLocation(MINLOCID, MAXLOCID);
+        for (int i = 0; i < perThread; i++) {
+            dataLists[t].push_back(DNA(sequencer(12, t * perThread + i), RndLocation.getRandNum()));
+        }
+    }
+    // every writer also reads back what it and the others inserted
+    std::atomic<uint64_t> inserted(0), misses(0);
+    vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&, t] {
+            for (const auto& D : dataLists[t]) {
+                if (dnadb.insert(D)) {
+                    inserted++;
+                    if (!dnadb.contains(D.getSequence(), D.getLocId())) {
+                        misses++;
+                    }
+                }
+                const DNA& other = dataLists[(t + 1) % threads][&D - &dataLists[t][0]];
+                dnadb.getDNA(other.getSequence(), other.getLocId());
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    uint64_t total = 0;
+    for (unsigned i = 0; i < dnadb.m_numShards; i++) {
+        total += dnadb.m_shards[i].db->m_currentSize - dnadb.m_shards[i].db->m_currNumDeleted;
+        if (dnadb.m_shards[i].db->m_currentSize == 0) {
+            cout << "Shard " << i << " is empty" << endl;
+            return false;
+        }
+    }
+    if (misses != 0 || total != inserted) {
+        cout << misses << " misses, " << total << " of " << inserted << " entries stored" << endl;
+        return false;
+    }
+    // concurrent removes, each thread its own slice
+    workers.clear();
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&, t] {
+            for (size_t i = 0; i < dataLists[t].size(); i += 2) {
+                dnadb.remove(dataLists[t][i]);
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    for (int t = 0; t < threads; t++) {
+        for (size_t i = 0; i < dataLists[t].size(); i++) {
+            const DNA& D = dataLists[t][i];
+            if (dnadb.contains(D.getSequence(), D.getLocId()) != (i % 2 == 1)) {
+                cout << "Remove Failed" << endl;
+                return false;
+            }
+        }
+    }
+    cout << inserted << " entries over " << dnadb.shards() << " shards, capacity "
+         << dnadb.capacity() << endl;
+    cout << "Test Successful" << endl;
+    return true;
+}
+
+bool Tester::test_concurrent_hash_once() {
+    cout << endl << "Testing Sharded Operations Hash Each Key Once" << endl;
+    ConcurrentDnaDb dnadb(MINPRIME, countingHash, TABLE_MODE::PRIME, 8);
+    vector<DNA> dataList;
+    for (int i = 0; i < 2000; i++) {
+        dataList.push_back(DNA(sequencer(20, i), MINLOCID + i));
+    }
+    // the hash picks the shard and is reused by the shard's table,
+    // rehashes included, which re-index from the cached hashes
+    hashCalls = 0;
+    for (const DNA& D : dataList) {
+        dnadb.insert(D);
+    }
+    for (const DNA& D : dataList) {
+        if (!dnadb.contains(D.getSequence(), D.getLocId()) ||
+            !(dnadb.getDNA(D.getSequence(), D.getLocId()) == D)) {
+            cout << "Lookup of " << D << " failed" << endl;
+            return false;
+        }
+    }
+    for (size_t i = 0; i < dataList.size(); i += 2) {
+        dnadb.remove(dataList[i]);
+    }
+    dnadb.emplace(dataList[0].getSequence(), dataList[0].getLocId());
+    uint64_t expected = 3 * dataList.size() + dataList.size() / 2 + 1;
+    if (hashCalls != expected) {
+        cout << hashCalls << " hashes for " << expected << " operations" << endl;
+        return false;
+    }
+    // the shard is the one the table's own hash picks
+    for (size_t i = 1; i < dataList.size(); i += 2) {
+        const DNA& D = dataList[i];
+        if (dnadb.shard_of(hashCode(D.getSequence())).db->find(D.getSequence(), D.getLocId()) == nullptr) {
+            cout << D << " is not in the shard its hash picks" << endl;
+            return false;
+        }
+    }
+    cout << "Test Successful" << endl;
+    return true;
+}
+
+bool Tester::test_lock_free_churn() {
+    cout << endl << "Testing Lock-Free Table Capacity under Remove/Insert Churn" << endl;
+    LockFreeDnaDb dnadb(MINPRIME, nullptr);
+    vector<DNA> dataList;
+    for (int i = 0; i < 1000; i++) {
+        dataList.push_back(DNA(sequencer(16, i), MINLOCID + i));
+        dnadb.insert(dataList.back());
+    }
+    // the live count never changes, only tombstones pile up between
+    // resizes, which must compact them instead of growing the table
+    uint64_t maxCap = 0;
+    for (int round = 0; round < 200; round++) {
+        for (const DNA& D : dataList) {
+            if (!dnadb.remove(D) || !dnadb.insert(D)) {
+                cout << "Churn lost " << D << endl;
+                return false;
+            }
+        }
+        maxCap = max(maxCap, dnadb.capacity());
+    }
+    for (const DNA& D : dataList) {
+        if (!dnadb.contains(D.getSequence(), D.getLocId())) {
+            cout << "Missing " << D << " after the churn" << endl;
+            return false;
+        }
+    }
+    cout << dnadb.size() << " live entries, capacity peaked at " << maxCap << endl;
+    if (dnadb.size() != dataList.size() || maxCap > 8 * dataList.size()) {
+        cout << "The table kept growing under churn" << endl;
+        return false;
+    }
+    cout << "Test Successful" << endl;
+    return true;
+}
+
+bool Tester::test_lock_free() {
+    cout << endl << "Testing Lock-Free Table with Resizes under Concurrent Readers" << endl;
+    const int writers = 2;
+    const int perWriter = 6000;
+    LockFreeDnaDb dnadb(MINPRIME, nullptr);
+    // a resident set that must stay visible through every resize
+    vector<DNA> resident;
+    Random RndLocation(MINLOCID, MAXLOCID);
+    for (int i = 0; i < 2000; i++) {
+        DNA dataObj = DNA(sequencer(16, i), RndLocation.getRandNum());
+        if (dnadb.insert(dataObj)) {
+            resident.push_back(dataObj);
+        }
+    }
+    vector<vector<DNA>> dataLists(writers);
+    for (int t = 0; t < writers; t++) {
+        for (int i = 0; i < perWriter; i++) {
+            dataLists[t].push_back(DNA(sequencer(16, 100000 + t * perWriter + i), RndLocation.getRandNum()));
+        }
+    }
+    std::atomic<bool> writing(true);
+    std::atomic<uint64_t> misses(0), lookups(0);
+    vector<std::thread> threads;
+    for (int t = 0; t < 2; t++) {
+        threads.emplace_back([&, t] {
+            size_t i = t;
+            while (writing || i < resident.size()) {
+                const DNA& D = resident[i % resident.size()];
+                if (!(dnadb.getDNA(D.getSequence(), D.getLocId()) == D)) {
+                    misses++;
+                }
+                lookups++;
+                i++;
+            }
+        });
+    }
+    // writers insert their keys and remove every third one again, which
+    // forces several resizes while the readers run
+    std::atomic<uint64_t> failed(0);
+    vector<std::thread> writerThreads;
+    for (int t = 0; t < writers; t++) {
+        writerThreads.emplace_back([&, t] {
+            for (size_t i = 0; i < dataLists[t].size(); i++) {
+                if (!dnadb.insert(dataLists[t][i])) {
+                    failed++;
+                }
+                if (i % 3 == 0 && !dnadb.remove(dataLists[t][i])) {
+                    failed++;
+                }
+            }
+        });
+    }
+    for (auto& thread : writerThreads) {
+        thread.join();
+    }
+    writing = false;
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    if (misses != 0 || failed != 0) {
+        cout << misses << " of " << lookups << " lookups missed, " << failed << " writes failed" << endl;
+        return false;
+    }
+    uint64_t expected = resident.size();
+    for (int t = 0; t < writers; t++) {
+        for (size_t i = 0; i < dataLists[t].size(); i++) {
+            const DNA& D = dataLists[t][i];
+            if (dnadb.contains(D.getSequence(), D.getLocId()) != (i % 3 != 0)) {
+                cout << "Wrong contents after concurrent writes" << endl;
+                return false;
+            }
+            expected += i % 3 != 0;
+        }
+    }
+    if (dnadb.size() != expected || dnadb.insert(resident[0]) || !dnadb.remove(resident[0])) {
+        cout << "Size " << dnadb.size() << ", expected " << expected << endl;
+        return false;
+    }
+    cout << dnadb.size() << " entries, capacity " << dnadb.capacity() << endl;
+    cout << "Test Successful" << endl;
+    return true;
+}
+
+bool Tester::test_find_many() {
+    cout << endl << "Testing Batched Lookups against find" << endl;
+    for (TABLE_MODE mode : {TABLE_MODE::PRIME, TABLE_MODE::SWISS,
+                            TABLE_MODE::ROBIN_HOOD}) {
+        DnaDb dnadb(MINPRIME, nullptr, mode);
+        dnadb.setRehashBudget(1);
+        Random RndLocation(MINLOCID, MAXLOCID);
+        vector<string> sequences;
+        vector<int> locations;
+        for (int i = 0; i < 3000; i++) {
+            DNA dataObj = DNA(sequencer(10, i), RndLocation.getRandNum());
+            // every other key is only queried, never inserted
+            if (i % 2 == 0) {
+                dnadb.insert(dataObj);
+            }
+            sequences.push_back(dataObj.getSequence());
+            locations.push_back(i % 97 == 0 ? MAXLOCID + 1 : dataObj.getLocId());
+        }
+        if (dnadb.m_oldTable == nullptr) {
+            // keep a migration running so both tables are searched
+            dnadb.rehash();
+        }
+        vector<string_view> views(sequences.begin(), sequences.end());
+        vector<const DNA*> results(views.size());
+        vector<DNA> copies(views.size());
+        size_t found = dnadb.findMany(views.data(), locations.data(), views.size(), results.data());
+        dnadb.getDNABatch(views.data(), locations.data(), views.size(), copies.data());
+        size_t expected = 0;
+        for (size_t i = 0; i < views.size(); i++) {
+            const DNA* dna = dnadb.find(views[i], locations[i]);
+            expected += dna != nullptr;
+            if (results[i] != dna || !(copies[i] == dnadb.getDNA(views[i], locations[i]))) {
+                cout << "Batch result " << i << " differs from find" << endl;
+                return false;
+            }
+        }
+        if (found != expected || found == 0) {
+            cout << "Found " << found << ", expected " << expected << endl;
+            return false;
+        }
+        cout << found << " of " << views.size() << " keys found" << endl;
+    }
+    cout << "Test Successful" << endl;
+    return true;
+}
+
+bool Tester::test_bulk_load() {
+    cout << endl << "Testing Bulk Load against Repeated Inserts" << endl;
+    vector<DNA> dataList;
+    Random RndLocation(MINLOCID, MAXLOCID);
+    for (int i = 0; i < 20000; i++) {
+        dataList.push_back(DNA(sequencer(14, i), RndLocation.getRandNum()));
+        if (i % 50 == 0) {
+            dataList.push_back(dataList[i / 2]);    // duplicates are skipped
+        }
+    }
+    dataList.push_back(DNA("ACGT", MAXLOCID + 1));  // and so are bad locations
+    for (TABLE_MODE mode : {TABLE_MODE::PRIME, TABLE_MODE::POWER_OF_TWO, TABLE_MODE::SWISS,
+                            TABLE_MODE::ROBIN_HOOD}) {
+        for (unsigned threads : {1u, 4u}) {
+            DnaDb reference(MINPRIME, hashCode, mode);
+            uint64_t expected = 0;
+            for (const auto& D : dataList) {
+                expected += reference.insert(D);
+            }
+            DnaDb dnadb(dataList.data(), dataList.size(), hashCode, mode, threads);
+            if (dnadb.m_currentSize != expected || dnadb.m_oldTable != nullptr ||
+                dnadb.lambda() > dnadb.max_load()) {
+                cout << "Loaded " << dnadb.m_currentSize << " of " << expected << " entries" << endl;
+                return false;
+            }
+            for (const auto& D : dataList) {
+                if (!(dnadb.getDNA(D.getSequence(), D.getLocId()) == reference.getDNA(D.getSequence(), D.getLocId()))) {
+                    cout << "Bulk loaded table differs from inserts" << endl;
+                    return false;
+                }
+            }
+            // a second load into a filled table, some keys repeated
+            vector<DNA> more;
+            for (int i = 0; i < 5000; i++) {
+                more.push_back(DNA(sequencer(14, 50000 + i), RndLocation.getRandNum()));
+            }
+            more.push_back(dataList[0]);
+            if (dnadb.bulkLoad(more.data(), more.size(), threads) != 5000 ||
+                !dnadb.insert(DNA("ACGTACGT", MINLOCID)) || dnadb.insert(more[10])) {
+                cout << "Second bulk load failed" << endl;
+                return false;
+            }
+            for (const auto& D : more) {
+                if (dnadb.find(D.getSequence(), D.getLocId()) == nullptr) {
+                    cout << "Lost an entry of the second bulk load" << endl;
+                    return false;
+                }
+            }
+        }
+    }
+    cout << "Test Successful" << endl;
+    return true;
+}
+
+bool Tester::test_snapshot() {
+    cout << endl << "Testing Snapshot Save and Mapped Reopen" << endl;
+    const string path = "mytest_snapshot.bin";
+    for (TABLE_MODE mode : {TABLE_MODE::PRIME, TABLE_MODE::SWISS}) {
+        DnaDb dnadb(MINPRIME, hashCode, mode);
+        dnadb.setRehashBudget(1);
+        vector<DNA> dataList;
+        Random RndLocation(MINLOCID, MAXLOCID);
+        for (int i = 0; i < 3000; i++) {
+            // short, spilled and raw keys
+            int length = i % 3 == 0 ? 70 : 12;
+            string sequence = sequencer(length, i) + (i % 10 == 0 ? "N" : "");
+            DNA dataObj = DNA(sequence, RndLocation.getRandNum());
+            if (dnadb.insert(dataObj)) {
+                dataList.push_back(dataObj);
+            }
+        }
+        for (size_t i = 0; i < dataList.size(); i += 5) {
+            dnadb.remove(dataList[i]);
+        }
+        if (dnadb.m_oldTable == nullptr) {
+            dnadb.rehash();     // save must see both tables
+        }
+        if (!dnadb.saveSnapshot(path)) {
+            cout << "Could not write the snapshot" << endl;
+            return false;
+        }
+        DnaDbView view;
+        if (!view.open(path) || view.size() != dataList.size() - (dataList.size() + 4) / 5) {
+            cout << "Could not reopen the snapshot" << endl;
+            return false;
+        }
+        for (size_t i = 0; i < dataList.size(); i++) {
+            const DNA& D = dataList[i];
+            DNA found = view.getDNA(D.getSequence(), D.getLocId());
+            if ((i % 5 == 0) != (found == EMPTY) || (i % 5 != 0 && !(found == D))) {
+                cout << "Snapshot lookup " << i << " differs from the table" << endl;
+                return false;
+            }
+        }
+        if (view.contains(dataList[1].getSequence(), dataList[1].getLocId() == MAXLOCID ? MINLOCID : dataList[1].getLocId() + 1)) {
+            cout << "Found a key that was never inserted" << endl;
+            return false;
+        }
+        cout << view.size() << " entries in " << view.capacity() << " mapped slots" << endl;
+    }
+    // a damaged header is rejected instead of mapped
+    {
+        fstream file(path, ios::in | ios::out | ios::binary);
+        file.seekp(8);
+        file.put(char(SNAPSHOTVERSION + 1));
+    }
+    DnaDbView view;
+    bool opened = view.open(path) || view.open("no_such_snapshot.bin");
+    remove(path.c_str());
+    if (opened) {
+        cout << "Opened a bad snapshot" << endl;
+        return false;
+    }
+    cout << "Test Successful" << endl;
+    return true;
+}
+
+bool Tester::test_snapshot_damaged() {
+    cout << endl << "Testing Snapshot Reopen of Truncated and Damaged Files" << endl;
+    const string path = "mytest_damaged.bin";
+    DnaDb dnadb(MINPRIME, hashCode, TABLE_MODE::SWISS);
+    for (int i = 0; i < 500; i++) {
+        // spilled keys, so the file has an arena
+        dnadb.insert(DNA(sequencer(i % 2 == 0 ? 70 : 12, i), MINLOCID + i));
+    }
+    if (!dnadb.saveSnapshot(path)) {
+        cout << "Could not write the snapshot" << endl;
+        return false;
+    }
+    string good;
+    {
+        ifstream file(path, ios::binary);
+        good.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+    }
+    SnapshotHeader header;
+    memcpy(&header, good.data(), sizeof(header));
+    // each file is the snapshot cut short, or with one header field broken
+    vector<pair<string, string>> damaged;
+    auto patch = [&](const string& name, uint64_t fileBytes, auto change) {
+        SnapshotHeader bad = header;
+        change(bad);
+        string bytes = good.substr(0, fileBytes);
+        memcpy(&bytes[0], &bad, sizeof(bad));
+        damaged.push_back({name, bytes});
+    };
+    auto keep = [](SnapshotHeader&) {};
+    damaged.push_back({"cut inside the header", good.substr(0, sizeof(header) / 2)});
+    patch("cut inside the arena", good.size() - 8, keep);
+    patch("cut inside the slots, header matching the cut", header.slotOffset + 64,
+          [&](SnapshotHeader& bad) { bad.fileBytes = header.slotOffset + 64; });
+    patch("capacity overflowing the slot section", good.size(),
+          [](SnapshotHeader& bad) { bad.capacity = 1ULL << 62; bad.size = 0; });
+    patch("arena words overflowing the file", good.size(),
+          [](SnapshotHeader& bad) { bad.arenaWords = ~0ULL / 4; });
+    patch("control tags wrapping past the end", good.size(),
+          [](SnapshotHeader& bad) { bad.ctrlOffset = ~0ULL - 63; });
+    patch("misaligned slots", good.size(),
+          [](SnapshotHeader& bad) { bad.slotOffset += 8; });
+    patch("control tags inside the header", good.size(),
+          [](SnapshotHeader& bad) { bad.ctrlOffset = 0; });
+    patch("overlapping sections", good.size(),
+          [&](SnapshotHeader& bad) { bad.arenaOffset = header.slotOffset; });
+    DnaDbView view;
+    for (const auto& [name, bytes] : damaged) {
+        {
+            ofstream file(path, ios::binary | ios::trunc);
+            file.write(bytes.data(), bytes.size());
+        }
+        if (view.open(path) || view.isOpen() || view.size() != 0) {
+            cout << "Opened a snapshot with " << name << endl;
+            remove(path.c_str());
+            return false;
+        }
+    }
+    // the intact file still opens
+    {
+        ofstream file(path, ios::binary | ios::trunc);
+        file.write(good.data(), good.size());
+    }
+    bool opened = view.open(path) && view.contains(sequencer(70, 0), MINLOCID);
+    view.close();
+    remove(path.c_str());
+    if (!opened) {
+        cout << "Could not reopen the intact snapshot" << endl;
+        return false;
+    }
+    cout << damaged.size() << " damaged files rejected" << endl;
+    cout << "Test Successful" << endl;
+    return true;
+}
+
+bool Tester::test_arena_storage() {
+    cout << endl << "Testing Arena Storage of Spilled Keys" << endl;
+    const int count = 4000;
+    vector<string> sequences;
+    vector<int> locations;
+    Random RndLocation(MINLOCID, MAXLOCID);
+    for (int i = 0; i < count; i++) {
+        // spilled packed keys and spilled raw keys
+        sequences.push_back(sequencer(100, i) + (i % 7 == 0 ? "N" : ""));
+        locations.push_back(RndLocation.getRandNum());
+    }
+    DNA kept;
+    for (TABLE_MODE mode : {TABLE_MODE::PRIME, TABLE_MODE::SWISS,
+                            TABLE_MODE::ROBIN_HOOD}) {
+        // packed keys, hashCode would build a string per migrated key
+        DnaDb dnadb(MINPRIME, nullptr, mode);
+        dnadb.setRehashBudget(count);
+        vector<bool> inserted(count);
+        unsigned long long before = allocations;
+        for (int i = 0; i < count; i++) {
+            inserted[i] = dnadb.emplace(sequences[i], locations[i]);
+        }
+        // tables and arena chunks only, not one buffer per key
+        unsigned long long used = allocations - before;
+        if (used > count / 20) {
+            cout << "Inserts allocated " << used << " times" << endl;
+            return false;
+        }
+        for (int i = 0; i < count; i += 2) {
+            dnadb.remove(DNA(sequences[i], locations[i]));
+        }
+        uint64_t full = dnadb.arenaBytes();
+        dnadb.rehash();
+        dnadb.finishRehash();
+        // the rehash compacted the removed keys away
+        if (dnadb.arenaBytes() >= full) {
+            cout << "Rehash kept " << dnadb.arenaBytes() << " of " << full << " arena bytes" << endl;
+            return false;
+        }
+        for (int i = 0; i < count; i++) {
+            const DNA* found = dnadb.find(sequences[i], locations[i]);
+            if ((found != nullptr) != (i % 2 == 1 && inserted[i]) ||
+                (found != nullptr && found->getSequence() != sequences[i])) {
+                cout << "Lookup " << i << " failed after compaction" << endl;
+                return false;
+            }
+        }
+        // copies out of the table own their words
+        kept = dnadb.getDNA(sequences[1], locations[1]);
+    }
+    if (kept.getSequence() != sequences[1]) {
+        cout << "A copy did not outlive its table" << endl;
+        return false;
+    }
+    cout << "Test Successful" << endl;
+    return true;
+}
+
+bool Tester::test_cached_hash() {
+    cout << endl << "Testing Cached Hashes across Rehashes" << endl;
+    for (TABLE_MODE mode : {TABLE_MODE::PRIME, TABLE_MODE::POWER_OF_TWO, TABLE_MODE::SWISS,
+                            TABLE_MODE::ROBIN_HOOD}) {
+        DnaDb dnadb(MINPRIME, countingHash, mode);
+        dnadb.setRehashBudget(1);
+        vector<string> sequences;
+        vector<int> locations;
+        Random RndLocation(MINLOCID, MAXLOCID);
+        for (int i = 0; i < 2000; i++) {
+            sequences.push_back(sequencer(i % 2 ? 10 : 50, i));
+            locations.push_back(RndLocation.getRandNum());
+        }
+        hashCalls = 0;
+        uint64_t rehashes = 0;
+        uint64_t cap = dnadb.capacity();
+        for (int i = 0; i < 2000; i++) {
+            dnadb.emplace(sequences[i], locations[i]);
+            rehashes += dnadb.capacity() != cap;
+            cap = dnadb.capacity();
+        }
+        // one hash per insert, migration reuses the cached ones
+        if (rehashes == 0 || hashCalls != 2000) {
+            cout << hashCalls << " hashes for 2000 inserts" << endl;
+            return false;
+        }
+        if (dnadb.m_oldTable == nullptr) {
+            dnadb.rehash();
+        }
+        // one hash per lookup, even when both tables are probed
+        hashCalls = 0;
+        for (int i = 0; i < 2000; i++) {
+            if (dnadb.getDNA(sequences[i], locations[i]).getLocId() != locations[i]) {
+                cout << "Lookup " << i << " failed" << endl;
+                return false;
+            }
+        }
+        if (hashCalls != 2000) {
+            cout << hashCalls << " hashes for 2000 lookups" << endl;
+            return false;
+        }
+    }
+    cout << "Test Successful" << endl;
+    return true;
+}
+
+bool Tester::test_hash_kinds() {
+    cout << endl << "Testing Built-in Hash Functions" << endl;
+    // lengths around the 8-base SWAR blocks and the 32-base words
+    vector<string> sequences;
+    for (int length : {0, 1, 7, 8, 9, 15, 16, 31, 32, 33, 63, 64, 65, 100}) {
+        sequences.push_back(sequencer(length, length));
+        sequences.push_back(sequencer(length, length) + "N");
+        sequences.push_back("n" + sequencer(length, length + 1));
+    }
+    for (HASH_KIND kind : {HASH_KIND::PACKED, HASH_KIND::WYHASH, HASH_KIND::ROLLING}) {
+        for (uint64_t seed : {0ULL, 12345ULL}) {
+            for (const string& S : sequences) {
+                PackedSeq key(S);
+                if (key.toString() != S || key.isPacked() != PackedSeq::packable(S) ||
+                    key.hash(kind, seed) != PackedSeq::hash(S, kind, seed)) {
+                    cout << "Packing or hashing of " << S << " differs" << endl;
+                    return false;
+                }
+            }
+            if (PackedSeq::hash("ACGTACGTACGT", kind, seed) == PackedSeq::hash("ACGTACGTACGT", kind, seed + 1) ||
+                PackedSeq::hash("ACGT", kind, seed) == PackedSeq::hash("ACGTA", kind, seed)) {
+                cout << "Seed or length does not change the hash" << endl;
+                return false;
+            }
+        }
+    }
+    // sliding the rolling hash gives the hash of every k-mer
+    string read = sequencer(200, 7);
+    const uint32_t k = 21;
+    RollingHash rolling(99);
+    uint64_t outPower = rolling.power(k - 1);
+    for (uint32_t i = 0; i < read.length(); i++) {
+        if (i >= k) {
+            rolling.drop(PackedSeq(read.substr(i - k, 1)).m_inline + 1, outPower);
+        }
+        rolling.push(PackedSeq(read.substr(i, 1)).m_inline + 1);
+        if (i + 1 >= k && RollingHash::finish(rolling.poly(), k, true) !=
+                PackedSeq::hash(string_view(read).substr(i + 1 - k, k), HASH_KIND::ROLLING, 99)) {
+            cout << "Rolled hash of k-mer " << i + 1 - k << " differs" << endl;
+            return false;
+        }
+    }
+    // every kind and mode stores and finds the same entries
+    for (HASH_KIND kind : {HASH_KIND::PACKED, HASH_KIND::WYHASH, HASH_KIND::ROLLING}) {
+        for (TABLE_MODE mode : {TABLE_MODE::PRIME, TABLE_MODE::POWER_OF_TWO, TABLE_MODE::SWISS,
+                                TABLE_MODE::ROBIN_HOOD}) {
+            DnaDb dnadb(MINPRIME, kind, 42, mode);
+            vector<DNA> dataList;
+            Random RndLocation(MINLOCID, MAXLOCID);
+            for (int i = 0; i < 1000; i++) {
+                DNA dataObj(sequencer(i % 4 ? 20 : 80, i) + (i % 9 ? "" : "N"), RndLocation.getRandNum());
+                if (dnadb.insert(dataObj)) {
+                    dataList.push_back(dataObj);
+                }
+            }
+            for (size_t i = 0; i < dataList.size(); i++) {
+                const DNA& D = dataList[i];
+                if (i % 2 == 0 && !dnadb.remove(D)) {
+                    cout << "Remove Failed!" << endl;
+                    return false;
+                }
+                if ((dnadb.find(D.getSequence(), D.getLocId()) != nullptr) != (i % 2 == 1)) {
+                    cout << "Find Failed!" << endl;
+                    return false;
+                }
+            }
+        }
+    }
+    cout << "Test Successful" << endl;
+    return true;
+}
+
+bool Tester::test_kmers() {
+    cout << endl << "Testing Rolling k-mer Insert and Find" << endl;
+    // a genome with a few N runs that break the windows
+    string genome = sequencer(3000, 11);
+    for (size_t i = 500; i < genome.length(); i += 700) {
+        genome[i] = 'N';
+    }
+    auto reverseComplement = [](const string& S) {
+        string R(S.rbegin(), S.rend());
+        for (char& base : R) {
+            base = base == 'A' ? 'T' : base == 'C' ? 'G' : base == 'G' ? 'C' : 'A';
+        }
+        return R;
+    };
+    string reversed = reverseComplement(genome);
+    const int location = 4242;
+    for (HASH_KIND kind : {HASH_KIND::ROLLING, HASH_KIND::PACKED}) {
+        for (uint32_t k : {21u, 40u}) {
+            for (bool canonical : {false, true}) {
+                DnaDb dnadb(MINPRIME, kind, 5, TABLE_MODE::SWISS);
+                uint64_t inserted = dnadb.insertKmers(genome, k, location, canonical);
+                uint64_t windows = 0;
+                for (size_t i = 0; i + k <= genome.length(); i++) {
+                    windows += genome.find('N', i) >= i + k;
+                }
+                // a random genome this long repeats no k-mer
+                if (inserted != windows) {
+                    cout << "Inserted " << inserted << " of " << windows << " k-mers" << endl;
+                    return false;
+                }
+                vector<const DNA*> results(genome.length() - k + 1);
+                unsigned long long before = allocations;
+                size_t found = dnadb.findKmers(genome, k, location, results.data(), canonical);
+                if (!canonical && k <= BASESPERWORD && allocations != before) {
+                    cout << "findKmers allocated " << allocations - before << " times" << endl;
+                    return false;
+                }
+                if (found != windows) {
+                    cout << "Found " << found << " of " << windows << " k-mers" << endl;
+                    return false;
+                }
+                for (size_t i = 0; i < results.size(); i++) {
+                    string window = genome.substr(i, k);
+                    if (window.find('N') != string::npos) {
+                        if (results[i] != nullptr) {
+                            cout << "Window " << i << " with an N was found" << endl;
+                            return false;
+                        }
+                        continue;
+                    }
+                    string key = results[i] == nullptr ? "" : results[i]->getSequence();
+                    if (key != window && !(canonical && key == reverseComplement(window))) {
+                        cout << "Window " << i << " found the wrong key" << endl;
+                        return false;
+                    }
+                    // non-canonical keys are plain entries, find agrees
+                    if (!canonical && dnadb.find(window, location) != results[i]) {
+                        cout << "find and findKmers differ at " << i << endl;
+                        return false;
+                    }
+                }
+                // the other strand only finds its k-mers in canonical mode
+                found = dnadb.findKmers(reversed, k, location, results.data(), canonical);
+                if (found != (canonical ? windows : 0)) {
+                    cout << "Found " << found << " reverse strand k-mers" << endl;
+                    return false;
+                }
+            }
+        }
+    }
+    cout << "Test Successful" << endl;
+    return true;
+}
+
+bool Tester::test_multimap() {
+    cout << endl << "Testing Multi-Location Sequences with Posting Lists" << endl;
+    for (hash_fn hash : {hashCode, (hash_fn)nullptr}) {
+        MultiDnaDb dnadb(MINPRIME, hash);
+        // a repeat seen at 500 locations next to 2000 unique sequences
+        string repeat = sequencer(60, 1);
+        Random RndLocation(MINLOCID, MAXLOCID);
+        vector<int> locations;
+        while (locations.size() < 500) {
+            int location = RndLocation.getRandNum();
+            if (dnadb.emplace(repeat, location)) {
+                locations.push_back(location);
+            }
+            else if (find(locations.begin(), locations.end(), location) == locations.end()) {
+                cout << "Insert of a new location failed" << endl;
+                return false;
+            }
+        }
+        vector<DNA> singles;
+        for (int i = 0; i < 2000; i++) {
+            singles.push_back(DNA(sequencer(i % 2 ? 20 : 70, i + 10), RndLocation.getRandNum()));
+            dnadb.insert(singles.back());
+        }
+        if (dnadb.size() != 2001 || dnadb.entries() != 2500 || dnadb.insert(DNA(repeat, locations[0]))) {
+            cout << "Wrong sequence or entry count" << endl;
+            return false;
+        }
+        sort(locations.begin(), locations.end());
+        if (dnadb.getLocations(repeat) != locations || dnadb.countLocations(repeat) != 500) {
+            cout << "getLocations differs from the inserted locations" << endl;
+            return false;
+        }
+        // at most two bytes per location
+        if (dnadb.postingBytes() > 2 * 500) {
+            cout << "Posting lists take " << dnadb.postingBytes() << " bytes" << endl;
+            return false;
+        }
+        // drop every other location of the repeat, and the unique entries
+        for (size_t i = 0; i < locations.size(); i += 2) {
+            if (!dnadb.remove(DNA(repeat, locations[i])) || dnadb.remove(DNA(repeat, locations[i]))) {
+                cout << "Remove Failed!" << endl;
+                return false;
+            }
+        }
+        for (const DNA& D : singles) {
+            dnadb.remove(D);
+        }
+        vector<int> kept;
+        for (size_t i = 1; i < locations.size(); i += 2) {
+            kept.push_back(locations[i]);
+            if (!dnadb.contains(repeat, locations[i]) || dnadb.contains(repeat, locations[i - 1])) {
+                cout << "contains Failed!" << endl;
+                return false;
+            }
+        }
+        if (dnadb.getLocations(repeat) != kept || dnadb.size() != 1 ||
+            !dnadb.getLocations(singles[0].getSequence()).empty()) {
+            cout << "Wrong locations after removal" << endl;
+            return false;
+        }
+    }
+    cout << "Test Successful" << endl;
+    return true;
+}
+
+bool Tester::test_stats() {
+    cout << endl << "Testing Table Statistics" << endl;
+    const string path = "mytest_stats.jsonl";
+    remove(path.c_str());
+    DnaDb dnadb(MINPRIME, nullptr);
+    dnadb.setRehashBudget(1);
+    dnadb.setStatsExport(path, 500);
+    vector<string> sequences;
+    for (int i = 0; i < 2000; i++) {
+        sequences.push_back(sequencer(i % 2 ? 10 : 50, i));
+        dnadb.emplace(sequences[i], MINLOCID + i % 9000);
+    }
+    if (dnadb.m_oldTable == nullptr) {
+        dnadb.rehash();
+    }
+    for (int i = 0; i < 2000; i++) {
+        dnadb.find(sequences[i], MINLOCID + i % 9000);     // hit
+        dnadb.find(sequences[i], MINLOCID + i % 9000 + 1); // miss
+    }
+    DnaDbStats stats = dnadb.stats();
+    if (stats.size != 2000 || stats.capacity != dnadb.capacity() || !stats.rehashing ||
+        stats.tableBytes < (dnadb.m_currentCap + dnadb.m_oldCap) * sizeof(DNA) ||
+        stats.arenaBytes != dnadb.arenaBytes() || stats.tombstones != dnadb.deletedRatio()) {
+        cout << "Table shape is off: " << stats.toJson() << endl;
+        return false;
+    }
+    uint64_t hitCount = 0, missCount = 0;
+    for (int b = 0; b < PROBEBUCKETS; b++) {
+        hitCount += stats.hitProbes[b];
+        missCount += stats.missProbes[b];
+    }
+    if (stats.counting) {
+        // lookups only, inserts probe without counting
+        if (stats.hits != 2000 || stats.misses != 2000 || hitCount != 2000 ||
+            missCount != 2000 || stats.oldHits + stats.currentHits != 2000 ||
+            stats.oldHits == 0 || stats.currentHits == 0 || stats.hitProbeTotal < 2000 ||
+            stats.missProbeTotal < 2000 || stats.rehashes == 0 ||
+            stats.slotsMigrated == 0 || stats.entriesMigrated > stats.slotsMigrated) {
+            cout << "Counters are off: " << stats.toJson() << endl;
+            return false;
+        }
+    }
+    else if (stats.hits != 0 || hitCount != 0 || stats.rehashes != 0) {
+        cout << "Counters without DNADB_STATS: " << stats.toJson() << endl;
+        return false;
+    }
+    // one export line per 500 writes
+    ifstream in(path);
+    string line;
+    int lines = 0;
+    while (getline(in, line)) {
+        lines += line.front() == '{' && line.back() == '}';
+    }
+    in.close();
+    bool written = dnadb.writeStats(path);
+    remove(path.c_str());
+    if (lines != 4 || !written) {
+        cout << lines << " stats lines for 2000 inserts" << endl;
+        return false;
+    }
+    cout << "Test Successful" << endl;
+    return true;
+}
+
+// identity hash, so the growth policy's reduction has to do the mixing
+struct IdentityHash {
+    uint64_t operator()(uint64_t key) const { return key; }
+};
+
+// transparent hash and equality, so string keys can be looked up by
+// string_view
+struct StringHash {
+    uint64_t operator()(string_view key) const { return std::hash<string_view>()(key); }
+};
+
+struct StringEqual {
+    bool operator()(const string& slot, string_view key) const { return slot == key; }
+};
+
+// random inserts and erases against std::map, across rehashes
+template <class Table>
+static bool check_against_map(const char* name) {
+    Table table(0);
+    table.setRehashBudget(1);
+    map<uint64_t, uint64_t> expected;
+    Random RndKey(0, 4000);
+    bool rehashed = false;
+    for (int i = 0; i < 40000; i++) {
+        uint64_t key = uint64_t(RndKey.getRandNum()) * 64;    // low bits all zero
+        bool present = expected.count(key) != 0;
+        if (i % 3 == 2) {
+            if (table.erase(key) != present) {
+                cout << name << ": erase of " << key << " disagrees" << endl;
+                return false;
+            }
+            expected.erase(key);
+        }
+        else {
+            if (table.insert(key, key + 1) == present) {
+                cout << name << ": insert of " << key << " disagrees" << endl;
+                return false;
+            }
+            expected.emplace(key, key + 1);
+        }
+        rehashed = rehashed || table.rehashing();
+        const uint64_t* value = table.find(key + 64 * (i % 5));
+        auto it = expected.find(key + 64 * (i % 5));
+        if ((value == nullptr) != (it == expected.end()) || (value != nullptr && *value != it->second)) {
+            cout << name << ": find of " << key << " disagrees" << endl;
+            return false;
+        }
+    }
+    uint64_t visited = 0;
+    table.forEach([&](uint64_t key, uint64_t value) { visited += expected.count(key) && value == key + 1; });
+    if (!rehashed || table.size() != expected.size() || visited != expected.size()) {
+        cout << name << ": " << table.size() << " entries, " << visited << " visited, "
+             << expected.size() << " expected" << endl;
+        return false;
+    }
+    return true;
+}
+
+bool Tester::test_generic_table() {
+    cout << endl << "Testing the Generic Hash Table Template" << endl;
+    if (!check_against_map<HashTable<uint64_t, uint64_t, IdentityHash, LinearProbe, PowerOfTwoGrowth<>>>("linear") ||
+        !check_against_map<HashTable<uint64_t, uint64_t, IdentityHash, LinearProbe, PowerOfTwoGrowth<80>>>("linear 80%") ||
+        !check_against_map<HashTable<uint64_t, uint64_t, IdentityHash, QuadraticProbe, PowerOfTwoGrowth<>>>("quadratic") ||
+        !check_against_map<HashTable<uint64_t, uint64_t, IdentityHash, QuadraticProbe, PrimeGrowth>>("quadratic prime") ||
+        !check_against_map<HashTable<uint64_t, uint64_t, IdentityHash, RobinHoodProbe, PowerOfTwoGrowth<90>>>("robin hood") ||
+        !check_against_map<HashTable<uint64_t, uint64_t, IdentityHash, RobinHoodProbe, PrimeGrowth>>("robin hood prime")) {
+        return false;
+    }
+    // string keys looked up by string_view, without building a string
+    HashTable<string, int, StringHash, QuadraticProbe, PrimeGrowth, StringEqual> table(MINPRIME);
+    table.setRehashBudget(1);
+    vector<string> keys;
+    for (int i = 0; i < 3000; i++) {
+        string key = sequencer(i % 2 ? 10 : 50, i % 1000);
+        bool fresh = std::find(keys.begin(), keys.end(), key) == keys.end();
+        // the value is the key's index in keys
+        if (table.insert(key, int(keys.size())) != fresh) {
+            cout << "Insert of " << key << " disagrees" << endl;
+            return false;
+        }
+        if (fresh) {
+            keys.push_back(key);
+        }
+    }
+    for (size_t i = 0; i < keys.size(); i++) {
+        string_view key = keys[i];
+        const int* value = table.find(key);
+        if (value == nullptr || *value != int(i) ||
+            table.contains(keys[i] + "N")) {
+            cout << "Lookup of " << keys[i] << " failed" << endl;
+            return false;
+        }
+        if (i % 2 == 0 && !table.erase(key)) {
+            cout << "Erase of " << keys[i] << " failed" << endl;
+            return false;
+        }
+    }
+    for (size_t i = 0; i < keys.size(); i++) {
+        if (table.contains(string_view(keys[i])) != (i % 2 == 1)) {
+            cout << "Erase left the table wrong at " << keys[i] << endl;
+            return false;
+        }
+    }
+    if (table.size() != keys.size() / 2) {
+        cout << table.size() << " entries left, " << keys.size() / 2 << " expected" << endl;
+        return false;
+    }
+    cout << "Test Successful" << endl;
+    return true;
+}
+
+bool Tester::test_robin_hood() {
+    cout << endl << "Testing Robin Hood Mode under Insert/Remove Churn" << endl;
+    DnaDb dnadb(MINPRIME, nullptr, TABLE_MODE::ROBIN_HOOD);
+    dnadb.setRehashBudget(1);
+    // every entry is at most one slot further from home than the one
+    // before it, and right at home after an empty slot
+    auto ordered = [&dnadb]() {
+        uint64_t cap = dnadb.m_currentCap;
+        for (uint64_t i = 0; i < cap; i++) {
+            uint64_t prev = (i + cap - 1) % cap;
+            if (dnadb.m_currentCtrl[i] < 0) {
+                continue;
+            }
+            uint64_t distance = dnadb.home_distance(dnadb.m_currentHashes, i, cap);
+            uint64_t before = dnadb.m_currentCtrl[prev] < 0
+                ? 0 : dnadb.home_distance(dnadb.m_currentHashes, prev, cap) + 1;
+            if (distance > before) {
+                return false;
+            }
+        }
+        return true;
+    };
+    vector<DNA> pool;
+    for (int i = 0; i < 4000; i++) {
+        pool.push_back(DNA(sequencer(i % 2 ? 10 : 50, i), MINLOCID + i % 7));
+    }
+    set<int> live;
+    for (int i = 0; i < 2000; i++) {
+        dnadb.insert(pool[i]);
+        live.insert(i);
+    }
+    dnadb.finishRehash();
+    uint64_t cap = dnadb.capacity();
+    // remove one, insert another: the live count stays put, so the table
+    // never needs to grow and there are no tombstones to force a rehash
+    Random RndIndex(0, 3999);
+    for (int i = 0; i < 40000; i++) {
+        auto it = live.lower_bound(RndIndex.getRandNum());
+        int victim = it == live.end() ? *live.begin() : *it;
+        int fresh = RndIndex.getRandNum();
+        if (!dnadb.remove(pool[victim])) {
+            cout << "Remove of a live entry failed" << endl;
+            return false;
+        }
+        live.erase(victim);
+        if (dnadb.insert(pool[fresh]) == (live.count(fresh) != 0)) {
+            cout << "Insert disagrees about a duplicate" << endl;
+            return false;
+        }
+        live.insert(fresh);
+        while (live.size() < 2000) {    // fresh was a duplicate
+            fresh = RndIndex.getRandNum();
+            if (live.insert(fresh).second) {
+                dnadb.insert(pool[fresh]);
+            }
+        }
+        if (dnadb.m_currNumDeleted != 0 || dnadb.m_oldTable != nullptr || dnadb.capacity() != cap) {
+            cout << "Churn left tombstones or forced a rehash" << endl;
+            return false;
+        }
+        if (i % 5000 == 0 && !ordered()) {
+            cout << "Probe order broken after " << i << " operations" << endl;
+            return false;
+        }
+    }
+    for (int i = 0; i < 4000; i++) {
+        DNA temp = dnadb.getDNA(pool[i].getSequence(), pool[i].getLocId());
+        if ((live.count(i) != 0) != (temp == pool[i])) {
+            cout << "Lookup of " << pool[i] << " disagrees" << endl;
+            return false;
+        }
+    }
+    if (dnadb.lambda() != float(live.size()) / dnadb.capacity() || !ordered()) {
+        cout << "Load factor counts more than the live entries" << endl;
+        return false;
+    }
+    cout << "Test Successful" << endl;
+    return true;
+}
+
+bool Tester::test_shrink() {
+    cout << endl << "Testing Shrinking, reserve() and shrinkToFit()" << endl;
+    vector<DNA> pool;
+    for (int i = 0; i < 20000; i++) {
+        pool.push_back(DNA(sequencer(i % 2 ? 10 : 150, i), MINLOCID + i % 7));
+    }
+    auto present = [&pool](const DnaDb& dnadb, int first, int last) {
+        for (int i = first; i < last; i++) {
+            if (dnadb.find(pool[i].getSequence(), pool[i].getLocId()) == nullptr) {
+                return false;
+            }
+        }
+        return true;
+    };
+    for (TABLE_MODE mode : {TABLE_MODE::PRIME, TABLE_MODE::POWER_OF_TWO,
+                            TABLE_MODE::SWISS, TABLE_MODE::ROBIN_HOOD}) {
+        // a spike and a collapse: removes shrink the table once the live
+        // entries drop under MINLOAD of it
+        DnaDb dnadb(MINPRIME, nullptr, mode);
+        for (const DNA& D : pool) {
+            dnadb.insert(D);
+        }
+        dnadb.finishRehash();
+        uint64_t peak = dnadb.capacity();
+        for (int i = 0; i < 19900; i++) {
+            uint64_t cap = dnadb.capacity();
+            uint64_t live = dnadb.m_currentSize - dnadb.m_currNumDeleted - 1;
+            bool tombstones = mode != TABLE_MODE::ROBIN_HOOD &&
+                float(dnadb.m_currNumDeleted + 1) / dnadb.m_currentSize > .8f;
+            dnadb.remove(pool[i]);
+            if (dnadb.capacity() < cap && dnadb.m_oldTable != nullptr &&
+                float(live) >= MINLOAD * cap && !tombstones) {
+                cout << "Shrank above the min load" << endl;
+                return false;
+            }
+        }
+        dnadb.finishRehash();
+        if (dnadb.capacity() >= peak / 8 || !present(dnadb, 19900, 20000) ||
+            dnadb.find(pool[0].getSequence(), pool[0].getLocId()) != nullptr) {
+            cout << "Collapse kept capacity " << dnadb.capacity() << " of " << peak << endl;
+            return false;
+        }
+        // 0 turns shrinking off: robin hood tables have no tombstones
+        // either, so nothing rehashes at all
+        if (mode == TABLE_MODE::ROBIN_HOOD) {
+            DnaDb kept(MINPRIME, nullptr, mode);
+            kept.setMinLoad(0);
+            for (const DNA& D : pool) {
+                kept.insert(D);
+            }
+            kept.finishRehash();
+            for (int i = 0; i < 19999; i++) {
+                kept.remove(pool[i]);
+            }
+            if (kept.capacity() != peak || kept.m_oldTable != nullptr || !present(kept, 19999, 20000)) {
+                cout << "Min load 0 still shrank" << endl;
+                return false;
+            }
+        }
+        // reserve() sizes once for the whole fill and holds through removes,
+        // shrinkToFit() then gives the room and the removed keys' words back
+        DnaDb reserved(MINPRIME, nullptr, mode);
+        reserved.reserve(pool.size());
+        uint64_t cap = reserved.capacity();
+        for (const DNA& D : pool) {
+            reserved.insert(D);
+        }
+        for (int i = 0; i < 19990; i++) {
+            reserved.remove(pool[i]);
+        }
+        uint64_t arena = reserved.arenaBytes();
+        if (reserved.capacity() != cap) {   // tombstones may rehash it at the same size
+            cout << "Reserved capacity " << cap << " changed to " << reserved.capacity() << endl;
+            return false;
+        }
+        if (!reserved.shrinkToFit() || reserved.m_oldTable != nullptr ||
+            reserved.capacity() >= cap / 8 || reserved.arenaBytes() >= arena ||
+            !present(reserved, 19990, 20000) || reserved.shrinkToFit()) {
+            cout << "shrinkToFit() left capacity " << reserved.capacity() << endl;
+            return false;
+        }
+        cout << "Capacity " << peak << " -> " << dnadb.capacity() << " after the collapse, "
+             << cap << " -> " << reserved.capacity() << " with shrinkToFit()" << endl;
+    }
+    cout << "Test Successful" << endl;
+    return true;
+}
+
+bool Tester::test_slot_allocator() {
+    cout << endl << "Testing Slot Allocators" << endl;
+    vector<DNA> pool;
+    set<pair<string, int>> seen;    // short keys repeat now and then
+    for (int i = 0; pool.size() < 100000; i++) {
+        DNA D(sequencer(i % 2 ? 12 : 40, i), MINLOCID + i % 11);
+        if (seen.insert({D.getSequence(), D.getLocId()}).second) {
+            pool.push_back(D);
+        }
+    }
+    auto present = [&pool](const DnaDb& dnadb, int first, int last) {
+        for (int i = first; i < last; i++) {
+            if (dnadb.find(pool[i].getSequence(), pool[i].getLocId()) == nullptr) {
+                return false;
+            }
+        }
+        return true;
+    };
+    // a plugged in allocator backs the table and every rehash of it, and
+    // gets every byte back
+    CountingAllocator counting;
+    {
+        DnaDb dnadb(MINPRIME, nullptr, TABLE_MODE::SWISS);
+        dnadb.insert(pool[0]);
+        dnadb.setSlotAllocator(&counting);
+        if (counting.outstanding == 0 || dnadb.m_oldTable != nullptr || !present(dnadb, 0, 1)) {
+            cout << "setSlotAllocator() did not move the table" << endl;
+            return false;
+        }
+        for (int i = 1; i < 50000; i++) {
+            dnadb.insert(pool[i]);
+        }
+        for (int i = 0; i < 45000; i++) {
+            dnadb.remove(pool[i]);
+        }
+        dnadb.shrinkToFit();
+        if (!present(dnadb, 45000, 50000)) {
+            cout << "Lookups failed on the plugged in allocator" << endl;
+            return false;
+        }
+        dnadb.setSlotAllocator(nullptr);
+        if (counting.outstanding != 0 || !present(dnadb, 45000, 50000)) {
+            cout << counting.outstanding << " bytes never returned" << endl;
+            return false;
+        }
+        dnadb.setSlotAllocator(&counting);
+    }
+    if (counting.outstanding != 0) {
+        cout << counting.outstanding << " bytes leaked by the destructor" << endl;
+        return false;
+    }
+    // every page size and placement, whatever the kernel makes of them
+    cout << SlotAllocator::numaNodes() << " NUMA node(s)" << endl;
+    for (PAGE_MODE pages : {PAGE_MODE::SMALL, PAGE_MODE::TRANSPARENT_HUGE, PAGE_MODE::EXPLICIT_HUGE}) {
+        for (NUMA_MODE numa : {NUMA_MODE::LOCAL, NUMA_MODE::INTERLEAVE, NUMA_MODE::BIND}) {
+            SlotAllocator allocator(pages, numa, 0);
+            DnaDb dnadb(MINPRIME, nullptr);
+            dnadb.setSlotAllocator(&allocator);
+            dnadb.reserve(pool.size());     // big enough to be mapped
+            for (const DNA& D : pool) {
+                dnadb.insert(D);
+            }
+            if (!present(dnadb, 0, int(pool.size()))) {
+                cout << "Lookups failed with page mode " << int(pages) << ", NUMA mode "
+                     << int(numa) << endl;
+                return false;
+            }
+            if (pages != PAGE_MODE::SMALL && uintptr_t(dnadb.m_currentTable) % HUGEPAGEBYTES != 0) {
+                cout << "Huge page table is not huge page aligned" << endl;
+                return false;
+            }
+            cout << "Page mode " << int(pages) << ", NUMA mode " << int(numa) << ": "
+                 << allocator.fallbacks() << " fallback(s)" << endl;
+        }
+    }
+    cout << "Test Successful" << endl;
+    return true;
+}
+
+bool Tester::test_fingerprints() {
+    cout << endl << "Testing Slot Fingerprints" << endl;
+    cout << DNADB_FINGERPRINT_BITS << "-bit fingerprints, " << 64 / sizeof(Fingerprint)
+         << " per cache line" << endl;
+    if (sizeof(Fingerprint) * 8 != DNADB_FINGERPRINT_BITS || 64 / sizeof(Fingerprint) < 8) {
+        cout << "Fingerprint type does not match DNADB_FINGERPRINT_BITS" << endl;
+        return false;
+    }
+    // every full slot's fingerprint is that of its hash, through inserts,
+    // removes, migration and robin hood shifts
+    auto consistent = [](const DNA* table, const int8_t* ctrl, const Fingerprint* prints,
+                         const uint64_t* hashes, uint64_t cap) {
+        for (uint64_t i = 0; table != nullptr && i < cap; i++) {
+            if (ctrl[i] >= 0 && prints[i] != DnaDb::fingerprint(hashes[i])) {
+                return false;
+            }
+        }
+        return true;
+    };
+    for (TABLE_MODE mode : {TABLE_MODE::PRIME, TABLE_MODE::POWER_OF_TWO,
+                            TABLE_MODE::SWISS, TABLE_MODE::ROBIN_HOOD}) {
+        for (hash_fn hash : {hash_fn(nullptr), hash_fn(hashCode)}) {
+            DnaDb dnadb(MINPRIME, hash, mode);
+            dnadb.setRehashBudget(1);
+            vector<DNA> dataList;
+            for (int i = 0; i < 6000; i++) {
+                dataList.push_back(DNA(sequencer(i % 3 ? 8 : 40, i), MINLOCID + i));
+            }
+            for (int i = 0; i < 6000; i++) {
+                dnadb.insert(dataList[i]);
+                if (i % 3 == 2) {
+                    dnadb.remove(dataList[i - 1]);
+                }
+                if (i % 500 == 0 &&
+                    (!consistent(dnadb.m_currentTable, dnadb.m_currentCtrl, dnadb.m_currentPrints,
+                                 dnadb.m_currentHashes, dnadb.m_currentCap) ||
+                     !consistent(dnadb.m_oldTable, dnadb.m_oldCtrl, dnadb.m_oldPrints,
+                                 dnadb.m_oldHashes, dnadb.m_oldCap))) {
+                    cout << "Fingerprint out of step with its hash" << endl;
+                    return false;
+                }
+            }
+            dnadb.finishRehash();
+            // probes trust the fingerprint: a slot whose fingerprint is off
+            // is never compared, so its entry goes missing
+            const DNA& D = dataList[0];
+            const DNA* found = dnadb.find(D.getSequence(), D.getLocId());
+            if (found == nullptr) {
+                cout << "Lookup of " << D << " failed" << endl;
+                return false;
+            }
+            uint64_t index = found - dnadb.m_currentTable;
+            dnadb.m_currentPrints[index] ^= 1;
+            bool hidden = dnadb.find(D.getSequence(), D.getLocId()) == nullptr;
+            dnadb.m_currentPrints[index] ^= 1;
+            if (!hidden || dnadb.find(D.getSequence(), D.getLocId()) != found) {
+                cout << "Probe did not go by the fingerprint" << endl;
+                return false;
+            }
+        }
+    }
+    cout << "Test Successful" << endl;
+    return true;
+}
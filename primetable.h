@@ -0,0 +1,98 @@
+#ifndef PRIMETABLE_H
+#define PRIMETABLE_H
+#include <cstdint>
+typedef unsigned __int128 uint128_t;
+
+// A growth prime paired with the magic number used by fastmod, so the
+// magic is computed once at compile time instead of on every rehash
+struct PrimeEntry{
+    uint64_t    prime;
+    uint128_t   magic;  // ceil(2^128 / prime)
+    constexpr PrimeEntry(uint64_t p) : prime(p), magic(~uint128_t(0) / p + 1) {}
+};
+
+// Lemire's fastmod: returns a % d using two multiplications and no divide,
+// exact for every 64-bit a and d when magic is ceil(2^128 / d)
+inline uint64_t fastmod(uint64_t a, uint128_t magic, uint64_t d) {
+    uint128_t lowbits = magic * a;
+    uint128_t bottom = (uint128_t(uint64_t(lowbits)) * d) >> 64;
+    uint128_t top = (lowbits >> 64) * d;
+    return uint64_t((bottom + top) >> 64);
+}
+
+// Growth primes, roughly four per doubling from MINPRIME up to 2^62
+constexpr PrimeEntry PRIMETABLE[] = {
+    101ULL, 127ULL, 149ULL, 173ULL,
+    211ULL, 241ULL, 293ULL, 347ULL,
+    409ULL, 487ULL, 577ULL, 683ULL,
+    809ULL, 967ULL, 1151ULL, 1361ULL,
+    1619ULL, 1931ULL, 2287ULL, 2719ULL,
+    3251ULL, 3847ULL, 4583ULL, 5437ULL,
+    6469ULL, 7691ULL, 9151ULL, 10883ULL,
+    12941ULL, 15377ULL, 18287ULL, 21751ULL,
+    25867ULL, 30757ULL, 36571ULL, 43487ULL,
+    51713ULL, 61507ULL, 73133ULL, 86969ULL,
+    103451ULL, 123001ULL, 146273ULL, 173969ULL,
+    206879ULL, 245989ULL, 292531ULL, 347887ULL,
+    413711ULL, 491977ULL, 585061ULL, 695771ULL,
+    827417ULL, 983951ULL, 1170109ULL, 1391519ULL,
+    1654787ULL, 1967891ULL, 2340223ULL, 2783009ULL,
+    3309571ULL, 3935779ULL, 4680451ULL, 5566013ULL,
+    6619139ULL, 7871573ULL, 9360887ULL, 11132029ULL,
+    13238273ULL, 15743059ULL, 18721753ULL, 22264031ULL,
+    26476553ULL, 31486109ULL, 37443499ULL, 44528101ULL,
+    52953097ULL, 62972197ULL, 74886997ULL, 89056127ULL,
+    105906179ULL, 125944387ULL, 149773963ULL, 178112257ULL,
+    211812353ULL, 251888761ULL, 299547949ULL, 356224541ULL,
+    423624727ULL, 503777513ULL, 599095811ULL, 712449007ULL,
+    847249439ULL, 1007555041ULL, 1198191629ULL, 1424898049ULL,
+    1694498833ULL, 2015110057ULL, 2396383217ULL, 2849795999ULL,
+    3388997659ULL, 4030220101ULL, 4792766431ULL, 5699591923ULL,
+    6777995293ULL, 8060440207ULL, 9585532897ULL, 11399183849ULL,
+    13555990529ULL, 16120880393ULL, 19171065659ULL, 22798367689ULL,
+    27111981079ULL, 32241760781ULL, 38342131319ULL, 45596735369ULL,
+    54223962119ULL, 64483521551ULL, 76684262687ULL, 91193470723ULL,
+    108447924239ULL, 128967043129ULL, 153368525309ULL, 182386941449ULL,
+    216895848473ULL, 257934086197ULL, 306737050559ULL, 364773882901ULL,
+    433791696901ULL, 515868172409ULL, 613474101011ULL, 729547765781ULL,
+    867583393861ULL, 1031736344759ULL, 1226948202037ULL, 1459095531571ULL,
+    1735166787643ULL, 2063472689521ULL, 2453896403999ULL, 2918191063147ULL,
+    3470333575207ULL, 4126945379023ULL, 4907792807971ULL, 5836382126209ULL,
+    6940667150423ULL, 8253890758123ULL, 9815585615929ULL, 11672764252381ULL,
+    13881334300681ULL, 16507781516101ULL, 19631171231879ULL, 23345528504807ULL,
+    27762668601359ULL, 33015563032181ULL, 39262342463699ULL, 46691057009507ULL,
+    55525337202689ULL, 66031126064369ULL, 78524684927431ULL, 93382114019023ULL,
+    111050674405417ULL, 132062252128747ULL, 157049369854901ULL, 186764228037979ULL,
+    222101348810773ULL, 264124504257511ULL, 314098739709527ULL, 373528456075963ULL,
+    444202697621521ULL, 528249008514919ULL, 628197479419049ULL, 747056912151911ULL,
+    888405395243017ULL, 1056498017029813ULL, 1256394958838113ULL, 1494113824303829ULL,
+    1776810790486031ULL, 2112996034059601ULL, 2512789917676201ULL, 2988227648607667ULL,
+    3553621580972033ULL, 4225992068119207ULL, 5025579835352477ULL, 5976455297215241ULL,
+    7107243161944069ULL, 8451984136238317ULL, 10051159670704751ULL, 11952910594430479ULL,
+    14214486323888129ULL, 16903968272476729ULL, 20102319341409523ULL, 23905821188860957ULL,
+    28428972647776301ULL, 33807936544953299ULL, 40204638682819153ULL, 47811642377721913ULL,
+    56857945295552549ULL, 67615873089906553ULL, 80409277365637921ULL, 95623284755443853ULL,
+    113715890591105029ULL, 135231746179813091ULL, 160818554731275797ULL, 191246569510887697ULL,
+    227431781182210051ULL, 270463492359626221ULL, 321637109462551601ULL, 382493139021775321ULL,
+    454863562364420107ULL, 540926984719252303ULL, 643274218925103151ULL, 764986278043550639ULL,
+    909727124728840199ULL, 1081853969438504579ULL, 1286548437850206239ULL, 1529972556087101209ULL,
+    1819454249457680399ULL, 2163707938877009167ULL, 2573096875700412431ULL, 3059945112174202409ULL,
+    3638908498915360789ULL, 4327415877754018337ULL,
+};
+const int NUMPRIMES = sizeof(PRIMETABLE) / sizeof(PRIMETABLE[0]);
+
+// Index of the first PRIMETABLE entry above current (or the last entry)
+inline int prime_index(uint64_t current) {
+    int low = 0, high = NUMPRIMES - 1;
+    while (low < high) {
+        int mid = (low + high) / 2;
+        if (PRIMETABLE[mid].prime > current) {
+            high = mid;
+        }
+        else {
+            low = mid + 1;
+        }
+    }
+    return low;
+}
+#endif
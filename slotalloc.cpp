@@ -0,0 +1,119 @@
+#include "slotalloc.h"
+#include <new>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+// mbind(2) policies, the syscall is made directly so there is no libnuma
+// to link against
+const int MPOLBIND = 2;
+const int MPOLINTERLEAVE = 3;
+const int MAXNODES = 64;    // nodes a policy mask can name
+
+SlotAllocator::SlotAllocator(PAGE_MODE pages, NUMA_MODE numa, int node)
+        :m_pages(pages), m_numa(numa), m_node(node), m_fallbacks(0) {}
+
+SlotAllocator& SlotAllocator::standard() {
+    static SlotAllocator allocator;
+    return allocator;
+}
+
+int SlotAllocator::numaNodes() {
+    //ranges like "0-1" or "0,2-3"
+    std::ifstream online("/sys/devices/system/node/online");
+    std::string range;
+    int nodes = 0;
+    while (std::getline(online, range, ',')) {
+        int first = 0, last = 0;
+        char dash = 0;
+        std::istringstream in(range);
+        in >> first;
+        last = (in >> dash >> last) ? last : first;
+        nodes += last - first + 1;
+    }
+    return nodes > 0 ? nodes : 1;
+}
+
+uint64_t SlotAllocator::mapped_bytes(uint64_t bytes) const {
+    if (m_pages == PAGE_MODE::SMALL) {
+        return bytes;   //munmap rounds up to a page itself
+    }
+    return (bytes + HUGEPAGEBYTES - 1) & ~(HUGEPAGEBYTES - 1);
+}
+
+void* SlotAllocator::allocate(uint64_t bytes) {
+    if (bytes < GIVEBACKBYTES) {
+        return ::operator new(bytes);
+    }
+    uint64_t length = mapped_bytes(bytes);
+    void* memory = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    if (m_pages == PAGE_MODE::EXPLICIT_HUGE) {
+        memory = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    }
+#endif
+    if (memory == MAP_FAILED) {
+        if (m_pages == PAGE_MODE::EXPLICIT_HUGE) {
+            m_fallbacks.fetch_add(1, std::memory_order_relaxed);   //pool too small
+        }
+        memory = m_pages == PAGE_MODE::SMALL
+            ? mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)
+            : map_aligned(length);
+        if (memory == MAP_FAILED) {
+            throw std::bad_alloc();     //as new would
+        }
+#ifdef MADV_HUGEPAGE
+        if (m_pages != PAGE_MODE::SMALL) {
+            madvise(memory, length, MADV_HUGEPAGE);
+        }
+#endif
+    }
+    place(memory, length);
+    return memory;
+}
+
+void SlotAllocator::deallocate(void* memory, uint64_t bytes) {
+    if (memory == nullptr) {
+        return;
+    }
+    if (bytes < GIVEBACKBYTES) {
+        ::operator delete(memory);
+    }
+    else {
+        munmap(memory, mapped_bytes(bytes));
+    }
+}
+
+void* SlotAllocator::map_aligned(uint64_t bytes) {
+    //over-map by a huge page and trim both ends, so the array starts on a
+    //huge page boundary and every 2 MB of it can be backed by one page
+    char* raw = static_cast<char*>(mmap(nullptr, bytes + HUGEPAGEBYTES, PROT_READ | PROT_WRITE,
+                                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    if (raw == MAP_FAILED) {
+        return MAP_FAILED;
+    }
+    uint64_t head = (HUGEPAGEBYTES - uint64_t(uintptr_t(raw)) % HUGEPAGEBYTES) % HUGEPAGEBYTES;
+    if (head != 0) {
+        munmap(raw, head);
+    }
+    munmap(raw + head + bytes, HUGEPAGEBYTES - head);
+    return raw + head;
+}
+
+void SlotAllocator::place(void* memory, uint64_t bytes) {
+    //before the first touch, the policy decides where each page faults in
+    if (m_numa == NUMA_MODE::LOCAL) {
+        return;
+    }
+    unsigned long mask = m_numa == NUMA_MODE::INTERLEAVE
+        ? ~0UL      //the kernel drops nodes that are offline or not allowed
+        : 1UL << (m_node % MAXNODES);
+    int policy = m_numa == NUMA_MODE::INTERLEAVE ? MPOLINTERLEAVE : MPOLBIND;
+    if (syscall(SYS_mbind, memory, bytes, policy, &mask, MAXNODES + 1, 0) != 0) {
+        m_fallbacks.fetch_add(1, std::memory_order_relaxed);
+    }
+}
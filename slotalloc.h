@@ -0,0 +1,64 @@
+#ifndef SLOTALLOC_H
+#define SLOTALLOC_H
+#include <cstdint>
+#include <atomic>
+
+const uint64_t GIVEBACKBYTES = 1 << 20;     // slot arrays this large get their own mapping
+const uint64_t HUGEPAGEBYTES = 2 << 20;     // x86-64 huge page, mappings are aligned to it
+
+// Page size of the mappings SlotAllocator makes for large arrays
+enum class PAGE_MODE {
+    SMALL,              // the kernel's default pages
+    TRANSPARENT_HUGE,   // huge page aligned, madvise(MADV_HUGEPAGE)
+    EXPLICIT_HUGE       // MAP_HUGETLB from the reserved pool, TRANSPARENT_HUGE
+                        // when the pool cannot cover the array
+};
+
+// Where those pages are placed on a multi-socket machine
+enum class NUMA_MODE {
+    LOCAL,              // the kernel's default, the node that first touches a page
+    INTERLEAVE,         // pages spread round robin over every node
+    BIND                // every page on one node
+};
+
+// Where a DnaDb gets its slot, control tag and hash arrays from, see
+// DnaDb::setSlotAllocator(). Arrays under GIVEBACKBYTES come from the heap,
+// larger ones get their own mapping so freeing them returns their pages
+// to the OS, with the page size and NUMA placement chosen here. Placement
+// and page size are hints: a kernel without NUMA or transparent huge page
+// support just maps ordinary pages. Derived classes may allocate however
+// they like, as long as deallocate() takes back what allocate() gave.
+// A per-node replica is one table per node, each with a BIND allocator.
+class SlotAllocator{
+public:
+    SlotAllocator(PAGE_MODE pages = PAGE_MODE::SMALL, NUMA_MODE numa = NUMA_MODE::LOCAL,
+                  int node = 0);
+    virtual ~SlotAllocator() {}
+    SlotAllocator(const SlotAllocator&) = delete;
+    SlotAllocator& operator=(const SlotAllocator&) = delete;
+    // Throws std::bad_alloc when out of memory, as new does
+    virtual void* allocate(uint64_t bytes);
+    virtual void deallocate(void* memory, uint64_t bytes);
+    PAGE_MODE pages() const { return m_pages; }
+    NUMA_MODE numa() const { return m_numa; }
+    // EXPLICIT_HUGE arrays that fell back to TRANSPARENT_HUGE, and large
+    // arrays whose NUMA policy the kernel refused
+    uint64_t fallbacks() const { return m_fallbacks.load(std::memory_order_relaxed); }
+    // Online NUMA nodes, 1 where the kernel reports none
+    static int numaNodes();
+    // SMALL pages, LOCAL placement, the allocator of every new DnaDb
+    static SlotAllocator& standard();
+
+private:
+    PAGE_MODE   m_pages;
+    NUMA_MODE   m_numa;
+    int         m_node;     // BIND only
+    std::atomic<uint64_t> m_fallbacks;
+
+    // bytes mapped for an array of bytes
+    uint64_t mapped_bytes(uint64_t bytes) const;
+    void* map_aligned(uint64_t bytes);
+    void place(void* memory, uint64_t bytes);
+};
+
+#endif
@@ -0,0 +1,215 @@
+#include "snapshot.h"
+#include <fstream>
+#include <vector>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+const uint64_t SNAPSHOTALIGN = 64;
+
+// part of the file format: the murmur3 finalizer DnaDb's SWISS mode uses
+static uint64_t snapshot_mix(uint64_t hash) {
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+static uint64_t align_up(uint64_t offset) {
+    return (offset + SNAPSHOTALIGN - 1) & ~(SNAPSHOTALIGN - 1);
+}
+
+// true when count items of itemBytes starting at offset lie within the
+// first end bytes of the file and start on a section boundary, checked
+// without letting a damaged header overflow the arithmetic
+static bool section_fits(uint64_t offset, uint64_t count, uint64_t itemBytes, uint64_t end) {
+    return offset % SNAPSHOTALIGN == 0 && offset <= end && count <= (end - offset) / itemBytes;
+}
+
+bool DnaDb::saveSnapshot(const string& path) const {
+    return DnaDbView::save(*this, path);
+}
+
+bool DnaDbView::save(const DnaDb& db, const string& path) {
+    //a background migrator must not move entries under us
+    std::unique_lock<std::mutex> guard(db.m_lock, std::defer_lock);
+    if (db.m_background) {
+        guard.lock();
+    }
+    vector<const DNA*> entries;
+    for (uint64_t i = 0; i < db.m_currentCap; i++) {
+        if (db.m_currentCtrl[i] >= 0) {
+            entries.push_back(&db.m_currentTable[i]);
+        }
+    }
+    for (uint64_t i = 0; i < db.m_oldCap; i++) {
+        if (db.m_oldTable != nullptr && db.m_oldCtrl[i] >= 0) {
+            entries.push_back(&db.m_oldTable[i]);
+        }
+    }
+    //at most half full keeps the probes short
+    uint64_t cap = SNAPSHOTALIGN;
+    while (cap < 2 * entries.size()) {
+        cap <<= 1;
+    }
+    vector<int8_t> ctrl(cap, CTRL_EMPTY);
+    vector<SnapshotSlot> slots(cap);
+    vector<uint64_t> arena;
+    for (const DNA* dna : entries) {
+        const PackedSeq& key = dna->m_sequence;
+        uint64_t hash = snapshot_mix(key.hash());
+        uint64_t index = (hash >> 7) & (cap - 1);
+        for (uint64_t step = 1; ctrl[index] != CTRL_EMPTY; step++) {
+            index = (index + step) & (cap - 1);    //Triangular Probing
+        }
+        ctrl[index] = int8_t(hash & 0x7F);
+        SnapshotSlot& slot = slots[index];
+        slot.length = key.m_length;
+        slot.location = dna->m_location;
+        slot.packed = key.m_packed;
+        if (key.isSpilled()) {
+            slot.word = arena.size();
+            arena.insert(arena.end(), key.m_words, key.m_words + key.numWords());
+        }
+        else {
+            slot.word = key.m_inline;
+        }
+    }
+
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOTMAGIC, sizeof(header.magic));
+    header.version = SNAPSHOTVERSION;
+    header.slotBytes = sizeof(SnapshotSlot);
+    header.capacity = cap;
+    header.size = entries.size();
+    header.seed = 0;
+    header.ctrlOffset = align_up(sizeof(header));
+    header.slotOffset = align_up(header.ctrlOffset + cap);
+    header.arenaOffset = align_up(header.slotOffset + cap * sizeof(SnapshotSlot));
+    header.arenaWords = arena.size();
+    header.fileBytes = header.arenaOffset + arena.size() * sizeof(uint64_t);
+
+    ofstream out(path, ios::binary | ios::trunc);
+    const char padding[SNAPSHOTALIGN] = {};
+    auto pad_to = [&](uint64_t offset) {
+        out.write(padding, offset - uint64_t(out.tellp()));
+    };
+    out.write((const char*)&header, sizeof(header));
+    pad_to(header.ctrlOffset);
+    out.write((const char*)ctrl.data(), cap);
+    pad_to(header.slotOffset);
+    out.write((const char*)slots.data(), cap * sizeof(SnapshotSlot));
+    pad_to(header.arenaOffset);
+    out.write((const char*)arena.data(), arena.size() * sizeof(uint64_t));
+    out.close();
+    return !out.fail();
+}
+
+DnaDbView::DnaDbView()
+        :m_map(nullptr), m_mapBytes(0), m_header(nullptr), m_ctrl(nullptr),
+         m_slots(nullptr), m_arena(nullptr) {}
+
+DnaDbView::~DnaDbView() {
+    close();
+}
+
+bool DnaDbView::open(const string& path) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || uint64_t(info.st_size) < sizeof(SnapshotHeader)) {
+        ::close(fd);
+        return false;
+    }
+    void* map = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);    //the mapping keeps the file open
+    if (map == MAP_FAILED) {
+        return false;
+    }
+    m_map = map;
+    m_mapBytes = info.st_size;
+    //everything is checked up front, lookups then trust the offsets. The
+    //sections must follow the header and each other in order, aligned and
+    //without overlapping, and end inside the file actually mapped.
+    const SnapshotHeader* header = (const SnapshotHeader*)map;
+    uint64_t cap = header->capacity;
+    if (memcmp(header->magic, SNAPSHOTMAGIC, sizeof(header->magic)) != 0 ||
+        header->version != SNAPSHOTVERSION || header->slotBytes != sizeof(SnapshotSlot) ||
+        header->seed != 0 || header->fileBytes != m_mapBytes ||
+        cap == 0 || (cap & (cap - 1)) != 0 || header->size > cap / 2 ||
+        header->ctrlOffset < sizeof(SnapshotHeader) ||
+        !section_fits(header->ctrlOffset, cap, 1, m_mapBytes) ||
+        header->slotOffset < header->ctrlOffset + cap ||
+        !section_fits(header->slotOffset, cap, sizeof(SnapshotSlot), m_mapBytes) ||
+        header->arenaOffset < header->slotOffset + cap * sizeof(SnapshotSlot) ||
+        !section_fits(header->arenaOffset, header->arenaWords, sizeof(uint64_t), m_mapBytes)) {
+        close();
+        return false;
+    }
+    const char* base = (const char*)map;
+    m_header = header;
+    m_ctrl = (const int8_t*)(base + header->ctrlOffset);
+    m_slots = (const SnapshotSlot*)(base + header->slotOffset);
+    m_arena = (const uint64_t*)(base + header->arenaOffset);
+    madvise(map, m_mapBytes, MADV_RANDOM);  //lookups jump around the table
+    return true;
+}
+
+void DnaDbView::close() {
+    if (m_map != nullptr) {
+        munmap(m_map, m_mapBytes);
+    }
+    m_map = nullptr;
+    m_mapBytes = 0;
+    m_header = nullptr;
+    m_ctrl = nullptr;
+    m_slots = nullptr;
+    m_arena = nullptr;
+}
+
+const SnapshotSlot* DnaDbView::find_slot(string_view sequence, int location) const {
+    if (m_header == nullptr || location < MINLOCID || location > MAXLOCID) {
+        return nullptr;
+    }
+    uint64_t mask = m_header->capacity - 1;
+    uint64_t hash = snapshot_mix(PackedSeq::hash(sequence));
+    int8_t tag = int8_t(hash & 0x7F);
+    uint64_t index = (hash >> 7) & mask;
+    //triangular probing visits every slot within capacity steps, the bound
+    //only matters for a damaged file without empty slots
+    for (uint64_t step = 1; step <= mask + 1 && m_ctrl[index] != CTRL_EMPTY; step++) {
+        const SnapshotSlot& slot = m_slots[index];
+        if (m_ctrl[index] == tag && slot.location == location) {
+            uint32_t numWords = PackedSeq::numWords(slot.length, slot.packed);
+            const uint64_t* words = numWords > 1 ? m_arena + slot.word : &slot.word;
+            //a spilled key must lie inside the arena, even in a damaged file
+            bool inArena = numWords <= 1 || (numWords <= m_header->arenaWords &&
+                                             slot.word <= m_header->arenaWords - numWords);
+            if (inArena && PackedSeq::equals(words, slot.length, slot.packed, sequence)) {
+                return &slot;
+            }
+        }
+        index = (index + step) & mask;
+    }
+    return nullptr;
+}
+
+bool DnaDbView::contains(string_view sequence, int location) const {
+    return find_slot(sequence, location) != nullptr;
+}
+
+DNA DnaDbView::getDNA(string_view sequence, int location) const {
+    const SnapshotSlot* slot = find_slot(sequence, location);
+    if (slot == nullptr) {
+        return EMPTY;
+    }
+    bool spilled = PackedSeq::numWords(slot->length, slot->packed) > 1;
+    const uint64_t* words = spilled ? m_arena + slot->word : &slot->word;
+    return DNA(PackedSeq::toString(words, slot->length, slot->packed), slot->location);
+}
@@ -0,0 +1,74 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+#include "dnadb.h"
+
+const char SNAPSHOTMAGIC[8] = {'D', 'N', 'A', 'D', 'B', 'S', 'N', 'P'};
+const uint32_t SNAPSHOTVERSION = 1;
+
+// Snapshot file layout (little endian, every section 64-byte aligned):
+//   SnapshotHeader
+//   control tags    capacity bytes, CTRL_EMPTY or the 7-bit hash tag
+//   slots           capacity SnapshotSlots
+//   arena           the key words of keys longer than one word
+// The table is rebuilt for the file with its own fixed scheme: a power-of-
+// two capacity at most half full, PackedSeq::hash() mixed like the SWISS
+// mode (low 7 bits the tag, the bits above the home slot) and triangular
+// probing. So a snapshot opens the same way whatever mode and hash the
+// DnaDb used.
+struct SnapshotHeader {
+    char        magic[8];       // SNAPSHOTMAGIC
+    uint32_t    version;        // SNAPSHOTVERSION
+    uint32_t    slotBytes;      // sizeof(SnapshotSlot)
+    uint64_t    capacity;       // slots, a power of two
+    uint64_t    size;           // entries
+    uint64_t    seed;           // hash seed, 0 is PackedSeq::hash()
+    uint64_t    ctrlOffset;     // byte offsets from the start of the file
+    uint64_t    slotOffset;
+    uint64_t    arenaOffset;
+    uint64_t    arenaWords;
+    uint64_t    fileBytes;
+};
+
+struct SnapshotSlot {
+    uint64_t    word;       // the key word, or its arena index when spilled
+    uint32_t    length;     // bases (or raw characters)
+    int32_t     location;
+    uint8_t     packed;
+    uint8_t     unused[7];
+};
+
+// A read-only DnaDb mapped straight from a snapshot file: opening it only
+// validates the header, lookups read the mapped pages directly. The pages
+// come from the page cache, so processes mapping the same file share them.
+class DnaDbView{
+public:
+    friend class Tester;
+    DnaDbView();
+    ~DnaDbView();
+    DnaDbView(const DnaDbView&) = delete;
+    DnaDbView& operator=(const DnaDbView&) = delete;
+    // Maps path, returns false if it is missing or not a valid snapshot
+    bool open(const string& path);
+    void close();
+    bool isOpen() const { return m_map != nullptr; }
+    bool contains(string_view sequence, int location) const;
+    // returns EMPTY when absent
+    DNA getDNA(string_view sequence, int location) const;
+    uint64_t size() const { return m_header == nullptr ? 0 : m_header->size; }
+    uint64_t capacity() const { return m_header == nullptr ? 0 : m_header->capacity; }
+
+    // Writes db's entries (both tables, if it is mid rehash) to path
+    static bool save(const DnaDb& db, const string& path);
+
+private:
+    void*                   m_map;
+    size_t                  m_mapBytes;
+    const SnapshotHeader*   m_header;
+    const int8_t*           m_ctrl;
+    const SnapshotSlot*     m_slots;
+    const uint64_t*         m_arena;
+
+    const SnapshotSlot* find_slot(string_view sequence, int location) const;
+};
+
+#endif